@@ -0,0 +1,308 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <boost/describe/class.hpp>
+#include <msgpack.hpp>
+#include "nanobench.h"
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+#include "msgpack_describe.h"
+
+using namespace std::chrono_literals;
+using msgpackcpp::serialize;
+using msgpackcpp::deserialize;
+using msgpackcpp::sink;
+using msgpackcpp::source;
+
+//----------------------------------------------------------------------------------------------------------------
+
+// Global allocation counters, fed by the operator new replacements below
+struct alloc_stats
+{
+    size_t count{0};
+    size_t bytes{0};
+};
+
+inline std::atomic<size_t> g_alloc_count{0};
+inline std::atomic<size_t> g_alloc_bytes{0};
+
+inline alloc_stats alloc_snapshot()
+{
+    return {g_alloc_count.load(std::memory_order_relaxed), g_alloc_bytes.load(std::memory_order_relaxed)};
+}
+
+#ifdef ANKERL_NANOBENCH_IMPLEMENT
+// Replacements must be defined exactly once per program, so they live with nanobench's implementation.
+// The nothrow and array forms forward to these by default.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(size_t size)
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size)                   { return ::operator new(size); }
+void  operator delete(void* p) noexcept             { std::free(p); }
+void  operator delete[](void* p) noexcept           { std::free(p); }
+void  operator delete(void* p, size_t) noexcept     { std::free(p); }
+void  operator delete[](void* p, size_t) noexcept   { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+//----------------------------------------------------------------------------------------------------------------
+
+template<class Byte, class Allocator>
+struct vector_sink
+{
+    std::vector<Byte, Allocator>& buf;
+    vector_sink(std::vector<Byte, Allocator>& buf_) : buf{buf_} {}
+    void write(const char* data, size_t len) {buf.insert(end(buf), data, data + len);}
+};
+
+//----------------------------------------------------------------------------------------------------------------
+
+namespace custom_namespace
+{
+    struct custom_struct
+    {
+        char        c;
+        int8_t      i8;
+        uint8_t     u8;
+        int16_t     i16;
+        uint16_t    u16;
+        int32_t     i32;
+        uint32_t    u32;
+        int64_t     i64;
+        uint64_t    u64;
+        float       f32;
+        double      f64;
+        std::string str;
+
+        MSGPACK_DEFINE(c, i8, u8, i16, u16, i32, u32, i64, u64, f32, f64, str)
+    };
+
+    BOOST_DESCRIBE_STRUCT(custom_struct, (), (c, i8, u8, i16, u16, i32, u32, i64, u64, f32, f64, str))
+
+    struct custom_struct2
+    {
+        std::vector<custom_struct>      array;
+        std::map<int, custom_struct>    map;
+        std::vector<uint8_t>            binary;
+        MSGPACK_DEFINE(array, map, binary)
+    };
+
+    BOOST_DESCRIBE_STRUCT(custom_struct2, (), (array, map, binary))
+}
+
+//----------------------------------------------------------------------------------------------------------------
+
+inline std::string make_string()
+{
+    return  "and talk gravely to each"
+            "other; he read of the Obelisk in the Place de la Concorde that weeps"
+            "tears of granite in its lonely sunless exile and longs to be back by"
+            "the hot, lotus-covered Nile, where there are Sphinxes, and rose-red"
+            "ibises, and white vultures with gilded claws, and crocodiles with small"
+            "beryl eyes that crawl over the green steaming mud; he began to brood"
+            "over those verses which, drawing music from kiss-stained marble, tell"
+            "of that curious statue that Gautier compares to a contralto voice, the"
+            "_monstre charmant_ that couches in the porphyry-room of the Louvre."
+            "But after a time the book fell from his hand. He grew nervous, and a"
+            "horrible fit of terror came over him. What if Alan Campbell should be"
+            "out of England? Days would elapse before he could come back. Perhaps he"
+            "might refuse to come. What could he do then? Every moment was of vital"
+            "importance.";
+}
+
+template<class T>
+void random(T& obj, std::mt19937_64& gen)
+{
+    if constexpr(std::is_same_v<T, char> || std::is_same_v<T, int8_t> || std::is_same_v<T, uint8_t>)
+        obj = std::uniform_int_distribution<int>{std::numeric_limits<T>::min(), std::numeric_limits<T>::max()}(gen);
+    else if constexpr(std::is_integral_v<T>)
+        obj = std::uniform_int_distribution<T>{std::numeric_limits<T>::min(), std::numeric_limits<T>::max()}(gen);
+    else if constexpr (std::is_floating_point_v<T>)
+        obj = std::uniform_real_distribution<T>{std::numeric_limits<T>::min(), std::numeric_limits<T>::max()}(gen);
+}
+
+inline void random(custom_namespace::custom_struct& data, std::mt19937_64& eng)
+{
+    random(data.c, eng);
+    random(data.i8, eng);
+    random(data.u8, eng);
+    random(data.i16, eng);
+    random(data.u16, eng);
+    random(data.i32, eng);
+    random(data.u32, eng);
+    random(data.i64, eng);
+    random(data.u64, eng);
+    random(data.f32, eng);
+    random(data.f64, eng);
+    data.str = make_string();
+}
+
+inline std::mt19937_64 make_engine()
+{
+    return std::mt19937_64(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+}
+
+//----------------------------------------------------------------------------------------------------------------
+
+// Collects benchmark results together with the bytes and items processed and the heap allocations made per operation,
+// prints them from report() and optionally renders everything as csv/json (nanobench templates).
+// Command line: [--csv file] [--json file] [--filter substring] [--epoch-ms milliseconds (100)] [--epochs count (20)]
+class bench_suite
+{
+private:
+    ankerl::nanobench::Bench    bench;
+    std::string                 csv_file;
+    std::string                 json_file;
+    std::string                 filter;
+
+public:
+    bench_suite(int argc, char** argv, const char* title)
+    {
+        long   epoch_ms{100};
+        size_t epochs{20};
+
+        for (int i = 1 ; i + 1 < argc ; i += 2)
+        {
+            const std::string arg = argv[i];
+            if      (arg == "--csv")      csv_file  = argv[i+1];
+            else if (arg == "--json")     json_file = argv[i+1];
+            else if (arg == "--filter")   filter    = argv[i+1];
+            else if (arg == "--epoch-ms") epoch_ms  = std::stol(argv[i+1]);
+            else if (arg == "--epochs")   epochs    = std::stoul(argv[i+1]);
+        }
+
+        bench.title(title).unit("op").minEpochTime(std::chrono::milliseconds(epoch_ms)).epochs(epochs).relative(false);
+    }
+
+    bool enabled(const std::string& name) const
+    {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // Runs fn, which processes nbytes of msgpack and nitems items per call.
+    // Allocations are counted over separate calls so that nanobench's own bookkeeping isn't included.
+    template<class Fn>
+    void run(const std::string& name, size_t nbytes, size_t nitems, Fn&& fn)
+    {
+        if (!enabled(name))
+            return;
+
+        constexpr size_t iters = 16;
+        fn();
+        const alloc_stats before = alloc_snapshot();
+        for (size_t i = 0 ; i < iters ; ++i)
+            fn();
+        const alloc_stats after = alloc_snapshot();
+
+        bench.context("bytes",       std::to_string(nbytes))
+             .context("items",       std::to_string(nitems))
+             .context("allocs",      std::to_string(double(after.count - before.count) / iters))
+             .context("alloc_bytes", std::to_string(double(after.bytes - before.bytes) / iters))
+             .run(name, std::forward<Fn>(fn));
+    }
+
+    ankerl::nanobench::Bench& get() { return bench; }
+
+    void report()
+    {
+        using ankerl::nanobench::Result;
+
+        if (bench.results().empty())
+            return;
+
+        printf("\n| %-55s | %12s | %14s | %10s | %14s |\n", "benchmark", "MB/s", "items/s", "allocs/op", "alloc B/op");
+        printf("|%s|%s|%s|%s|%s|\n", std::string(57, '-').c_str(), std::string(14, '-').c_str(), std::string(16, '-').c_str(),
+                                     std::string(12, '-').c_str(), std::string(16, '-').c_str());
+        for (const Result& r : bench.results())
+        {
+            const double elapsed = r.median(Result::Measure::elapsed);
+            const double bytes   = std::stod(r.context("bytes"));
+            const double items   = std::stod(r.context("items"));
+            const double allocs  = std::stod(r.context("allocs"));
+            const double abytes  = std::stod(r.context("alloc_bytes"));
+            printf("| %-55s | %12.1f | %14.0f | %10.1f | %14.0f |\n", r.config().mBenchmarkName.c_str(), bytes / elapsed / 1e6, items / elapsed, allocs, abytes);
+        }
+
+        if (!csv_file.empty())
+        {
+            std::ofstream file(csv_file);
+            ankerl::nanobench::render(csv_template(), bench, file);
+        }
+
+        if (!json_file.empty())
+        {
+            std::ofstream file(json_file);
+            ankerl::nanobench::render(ankerl::nanobench::templates::json(), bench, file);
+        }
+    }
+
+    static const char* csv_template()
+    {
+        return R"DELIM("title";"name";"bytes";"items";"allocs";"alloc_bytes";"elapsed";"error %";"instructions";"branchmisses"
+{{#result}}"{{title}}";"{{name}}";{{context(bytes)}};{{context(items)}};{{context(allocs)}};{{context(alloc_bytes)}};{{median(elapsed)}};{{medianAbsolutePercentError(elapsed)}};{{median(instructions)}};{{median(branchmisses)}}
+{{/result}})DELIM";
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------
+
+// Benchmarks serialize/deserialize of obj with msgpackcpp and msgpack-c as a baseline
+template<class T>
+void bench_type(bench_suite& suite, const std::string& name, const T& obj, size_t nitems)
+{
+    std::vector<char> buf0;
+    auto out0 = sink(buf0);
+    serialize(out0, obj);
+
+    std::vector<char> buf1;
+    vector_sink out1(buf1);
+    msgpack::pack(out1, obj);
+
+    suite.run(name + " / msgpackcpp::serialize", buf0.size(), nitems, [&] {
+        buf0.clear();
+        auto out = sink(buf0);
+        serialize(out, obj);
+        ankerl::nanobench::doNotOptimizeAway(buf0.data());
+    });
+
+    suite.run(name + " / msgpack_c::serialize", buf1.size(), nitems, [&] {
+        buf1.clear();
+        vector_sink out(buf1);
+        msgpack::pack(out, obj);
+        ankerl::nanobench::doNotOptimizeAway(buf1.data());
+    });
+
+    suite.run(name + " / msgpackcpp::deserialize", buf0.size(), nitems, [&] {
+        T tmp;
+        auto in = source(buf0);
+        deserialize(in, tmp);
+        ankerl::nanobench::doNotOptimizeAway(tmp);
+    });
+
+    suite.run(name + " / msgpack_c::deserialize", buf1.size(), nitems, [&] {
+        msgpack::object_handle oh = msgpack::unpack(buf1.data(), buf1.size());
+        T tmp;
+        oh.get().convert(tmp);
+        ankerl::nanobench::doNotOptimizeAway(tmp);
+    });
+}
@@ -0,0 +1,3 @@
+// Compiles the explicit instantiations declared extern in BenchCompileExtern's translation units
+#define MSGPACK_INSTANTIATE_TEMPLATES
+#include "msgpack_extern.h"
@@ -0,0 +1,253 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include "common.h"
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BENCH_HAS_MMAP 1
+#endif
+
+// Sustained encode/decode throughput on datasets much larger than the caches.
+// A stream of custom_struct records is written through each sink and read back through each source.
+// Command line: [--size GB] [--dir directory] [--filter substring]
+//
+// In-memory sinks hold the whole dataset, so --size must fit in RAM. File reads are served from the
+// page cache unless the dataset is larger than the free memory.
+
+namespace fs = std::filesystem;
+using custom_namespace::custom_struct;
+
+struct dataset
+{
+    std::vector<custom_struct>  pool;       // records are cycled from here so generation isn't timed
+    size_t                      nrecords{0};
+    size_t                      nbytes{0};
+};
+
+struct measurement
+{
+    double  seconds{0};
+    size_t  bytes{0};
+    size_t  allocs{0};
+};
+
+//----------------------------------------------------------------------------------------------------------------
+
+dataset make_dataset(double gigabytes, std::mt19937_64& eng)
+{
+    dataset d;
+    d.pool.resize(1024);
+    for (auto& r : d.pool) random(r, eng);
+
+    std::vector<char> buf;
+    auto out = sink(buf);
+    for (const auto& r : d.pool) serialize(out, r);
+
+    const size_t target = size_t(gigabytes * 1e9);
+    d.nrecords = (target + buf.size() - 1) / buf.size() * d.pool.size();
+    d.nbytes   = d.nrecords / d.pool.size() * buf.size();
+    return d;
+}
+
+template<class Fn>
+measurement measure(Fn&& fn)
+{
+    const alloc_stats before = alloc_snapshot();
+    const auto        t0     = std::chrono::steady_clock::now();
+    measurement m;
+    m.bytes   = fn();
+    m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    m.allocs  = alloc_snapshot().count - before.count;
+    return m;
+}
+
+template<class Sink>
+size_t encode(Sink& out, const dataset& d)
+{
+    for (size_t i = 0 ; i < d.nrecords ; ++i)
+        serialize(out, d.pool[i % d.pool.size()]);
+    return d.nbytes;
+}
+
+template<class Source>
+size_t decode(Source& in, const dataset& d)
+{
+    custom_struct r;
+    int64_t       check{0};
+    for (size_t i = 0 ; i < d.nrecords ; ++i)
+    {
+        deserialize(in, r);
+        check += r.i64;
+    }
+    ankerl::nanobench::doNotOptimizeAway(check);
+    return d.nbytes;
+}
+
+void print(const std::string& name, const measurement& m)
+{
+    printf("| %-40s | %10.2f | %10.3f | %12zu |\n", name.c_str(), m.bytes / m.seconds / 1e9, m.seconds, m.allocs);
+    fflush(stdout);
+}
+
+//----------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    double      gigabytes = 1;
+    fs::path    dir       = fs::temp_directory_path();
+    std::string filter;
+
+    for (int i = 1 ; i + 1 < argc ; i += 2)
+    {
+        const std::string arg = argv[i];
+        if      (arg == "--size")   gigabytes = std::stod(argv[i+1]);
+        else if (arg == "--dir")    dir       = argv[i+1];
+        else if (arg == "--filter") filter    = argv[i+1];
+    }
+
+    const auto enabled = [&](const std::string& name) {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    };
+
+    auto          eng  = make_engine();
+    const dataset d    = make_dataset(gigabytes, eng);
+    const fs::path file = dir / "msgpack_cpp_streaming.bin";
+
+    printf("%zu records, %.2f GB, file %s\n\n", d.nrecords, d.nbytes / 1e9, file.string().c_str());
+    printf("| %-40s | %10s | %10s | %12s |\n", "benchmark", "GB/s", "seconds", "allocs");
+    printf("|%s|%s|%s|%s|\n", std::string(42, '-').c_str(), std::string(12, '-').c_str(), std::string(12, '-').c_str(), std::string(14, '-').c_str());
+
+    if (enabled("vector"))
+    {
+        std::vector<char> buf;
+        print("vector / encode", measure([&] {
+            auto out = sink(buf);
+            return encode(out, d);
+        }));
+        print("vector / decode", measure([&] {
+            auto in = source(buf);
+            return decode(in, d);
+        }));
+        print("vector / decode (trusted)", measure([&] {
+            auto in = msgpackcpp::trusted_source(buf);
+            return decode(in, d);
+        }));
+    }
+
+    if (enabled("segmented_buffer"))
+    {
+        msgpackcpp::segmented_buffer buf;
+        print("segmented_buffer / encode", measure([&] {
+            auto out = sink(buf);
+            return encode(out, d);
+        }));
+        print("segmented_buffer / decode", measure([&] {
+            auto in = source(buf);
+            return decode(in, d);
+        }));
+    }
+
+    if (enabled("stringstream"))
+    {
+        std::stringstream buf;
+        print("stringstream / encode", measure([&] {
+            auto out = sink(buf);
+            return encode(out, d);
+        }));
+        print("stringstream / decode", measure([&] {
+            auto in = source(buf);
+            return decode(in, d);
+        }));
+    }
+
+    if (enabled("stringstream buffered"))
+    {
+        std::stringstream buf;
+        print("stringstream buffered / encode", measure([&] {
+            auto out = msgpackcpp::buffered_sink(buf);
+            return encode(out, d);
+        }));
+        print("stringstream buffered / decode", measure([&] {
+            auto in = msgpackcpp::buffered_source(buf);
+            return decode(in, d);
+        }));
+    }
+
+    if (enabled("file"))
+    {
+        print("file / encode", measure([&] {
+            std::ofstream f(file, std::ios::binary);
+            auto out = sink(f);
+            return encode(out, d);
+        }));
+        print("file / decode", measure([&] {
+            std::ifstream f(file, std::ios::binary);
+            auto in = source(f);
+            return decode(in, d);
+        }));
+    }
+
+    if (enabled("file buffered"))
+    {
+        print("file buffered / encode", measure([&] {
+            std::ofstream f(file, std::ios::binary);
+            auto out = msgpackcpp::buffered_sink(f);
+            return encode(out, d);
+        }));
+        print("file buffered / decode", measure([&] {
+            std::ifstream f(file, std::ios::binary);
+            auto in = msgpackcpp::buffered_source(f);
+            return decode(in, d);
+        }));
+    }
+
+#ifdef BENCH_HAS_MMAP
+    if (enabled("mmap"))
+    {
+        // The dataset is left over from the file cases unless they were filtered out
+        if (!fs::exists(file))
+        {
+            std::ofstream f(file, std::ios::binary);
+            auto out = msgpackcpp::buffered_sink(f);
+            encode(out, d);
+        }
+
+        const int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            fprintf(stderr, "mmap: cannot open %s: %s\n", file.string().c_str(), strerror(errno));
+        }
+        else
+        {
+            const size_t size = fs::file_size(file);
+            void*        data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (data == MAP_FAILED)
+                fprintf(stderr, "mmap: cannot map %s: %s\n", file.string().c_str(), strerror(errno));
+            else
+            {
+                ::madvise(data, size, MADV_SEQUENTIAL);
+                print("mmap / decode", measure([&] {
+                    auto in = source((const char*)data, size);
+                    return decode(in, d);
+                }));
+                print("mmap / decode (trusted)", measure([&] {
+                    auto in = msgpackcpp::trusted_source((const char*)data, size);
+                    return decode(in, d);
+                }));
+                ::munmap(data, size);
+            }
+            ::close(fd);
+        }
+    }
+#endif
+
+    std::error_code ec;
+    fs::remove(file, ec);
+}
@@ -0,0 +1,255 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#include "common.h"
+
+namespace custom_namespace
+{
+    struct custom_struct_map : custom_struct
+    {
+        MSGPACK_DEFINE_MAP(c, i8, u8, i16, u16, i32, u32, i64, u64, f32, f64, str)
+    };
+}
+
+template<class Int>
+std::vector<Int> random_ints(size_t n, Int lo, Int hi, std::mt19937_64& eng)
+{
+    std::vector<Int> v(n);
+    std::uniform_int_distribution<Int> dist{lo, hi};
+    for (auto& x : v) x = dist(eng);
+    return v;
+}
+
+std::string random_string(size_t len, std::mt19937_64& eng)
+{
+    std::string str(len, ' ');
+    for (auto& c : str) c = 'a' + eng() % 26;
+    return str;
+}
+
+int main(int argc, char** argv)
+{
+    bench_suite suite(argc, argv, "msgpack types");
+    auto        eng = make_engine();
+    const size_t N  = 1000;
+
+    // Integers of every encoded width. Arrays keep the per-call overhead out of the measurement.
+    bench_type(suite, "int fixint",          random_ints<int64_t>(N, 0, 127, eng), N);
+    bench_type(suite, "int negative fixint", random_ints<int64_t>(N, -32, -1, eng), N);
+    bench_type(suite, "int u8",              random_ints<int64_t>(N, 128, 255, eng), N);
+    bench_type(suite, "int u16",             random_ints<int64_t>(N, 256, 65535, eng), N);
+    bench_type(suite, "int u32",             random_ints<int64_t>(N, 65536, 4294967295ll, eng), N);
+    bench_type(suite, "int u64",             random_ints<uint64_t>(N, 1ull << 32, std::numeric_limits<uint64_t>::max(), eng), N);
+    bench_type(suite, "int i8",              random_ints<int64_t>(N, -128, -33, eng), N);
+    bench_type(suite, "int i16",             random_ints<int64_t>(N, -32768, -129, eng), N);
+    bench_type(suite, "int i32",             random_ints<int64_t>(N, std::numeric_limits<int32_t>::min(), -32769, eng), N);
+    bench_type(suite, "int i64",             random_ints<int64_t>(N, std::numeric_limits<int64_t>::min(), std::numeric_limits<int32_t>::min() - 1ll, eng), N);
+
+    {
+        // All magnitudes mixed: worst case for branch prediction
+        auto v = random_ints<int64_t>(N, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), eng);
+        for (auto& x : v) x >>= eng() % 64;
+        bench_type(suite, "int mixed", v, N);
+    }
+
+    {
+        std::vector<float>  f(N);
+        std::vector<double> d(N);
+        for (auto& x : f) random(x, eng);
+        for (auto& x : d) random(x, eng);
+        bench_type(suite, "float32", f, N);
+        bench_type(suite, "float64", d, N);
+    }
+
+    {
+        std::vector<std::string> short_strings(N);
+        for (auto& s : short_strings) s = random_string(8 + eng() % 16, eng);
+        bench_type(suite, "string short", short_strings, N);
+
+        std::vector<std::string> long_strings(16);
+        for (auto& s : long_strings) s = random_string(16 * 1024, eng);
+        bench_type(suite, "string long", long_strings, long_strings.size());
+    }
+
+    {
+        std::vector<std::vector<uint8_t>> blobs(16, std::vector<uint8_t>(64 * 1024));
+        for (auto& b : blobs) for (auto& x : b) random(x, eng);
+        bench_type(suite, "bin 64k", blobs, blobs.size());
+    }
+
+    {
+        const size_t M = 1 << 20;
+        std::vector<double>  d(M);
+        for (auto& x : d) random(x, eng);
+        bench_type(suite, "vector<double> 1M", d, M);
+        bench_type(suite, "vector<int32_t> 1M", random_ints<int32_t>(M, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max(), eng), M);
+    }
+
+    {
+        std::map<int, int>          int_keys;
+        std::map<std::string, int>  str_keys;
+        for (size_t i = 0 ; i < N ; ++i)
+        {
+            int_keys[(int)eng()]                    = (int)eng();
+            str_keys["key_" + std::to_string(i)]    = (int)eng();
+        }
+        bench_type(suite, "map int keys",    int_keys, int_keys.size());
+        bench_type(suite, "map string keys", str_keys, str_keys.size());
+    }
+
+    {
+        std::vector<std::tuple<int, double, std::string>> tuples(N);
+        for (auto& [i, d, s] : tuples)
+        {
+            random(i, eng);
+            random(d, eng);
+            s = random_string(16, eng);
+        }
+        bench_type(suite, "tuple", tuples, N);
+    }
+
+    {
+        using custom_namespace::custom_struct;
+        using custom_namespace::custom_struct_map;
+
+        std::vector<custom_struct_map> structs(100);
+        for (auto& s : structs) random(s, eng);
+        const std::vector<custom_struct> as_array(begin(structs), end(structs));
+        bench_type(suite, "describe as_array", as_array, as_array.size());
+
+        // as_map: msgpackcpp with the as_map flag, msgpack-c with MSGPACK_DEFINE_MAP
+        const auto serialize_as_map = [&](std::vector<char>& buf) {
+            buf.clear();
+            auto out = sink(buf);
+            msgpackcpp::serialize_array_size(out, structs.size());
+            for (const custom_struct& s : structs)
+                serialize(out, s, true);
+        };
+
+        std::vector<char> buf0, buf1;
+        serialize_as_map(buf0);
+        vector_sink out1(buf1);
+        msgpack::pack(out1, structs);
+
+        suite.run("describe as_map / msgpackcpp::serialize", buf0.size(), structs.size(), [&] {
+            serialize_as_map(buf0);
+            ankerl::nanobench::doNotOptimizeAway(buf0.data());
+        });
+
+        suite.run("describe as_map / msgpack_c::serialize", buf1.size(), structs.size(), [&] {
+            buf1.clear();
+            vector_sink out(buf1);
+            msgpack::pack(out, structs);
+            ankerl::nanobench::doNotOptimizeAway(buf1.data());
+        });
+
+        suite.run("describe as_map / msgpackcpp::deserialize", buf0.size(), structs.size(), [&] {
+            auto in = source(buf0);
+            uint32_t size{};
+            msgpackcpp::deserialize_array_size(in, size);
+            std::vector<custom_struct> tmp(size);
+            for (auto& s : tmp)
+                deserialize(in, s, true);
+            ankerl::nanobench::doNotOptimizeAway(tmp);
+        });
+
+        suite.run("describe as_map / msgpack_c::deserialize", buf1.size(), structs.size(), [&] {
+            msgpack::object_handle oh = msgpack::unpack(buf1.data(), buf1.size());
+            std::vector<custom_struct_map> tmp;
+            oh.get().convert(tmp);
+            ankerl::nanobench::doNotOptimizeAway(tmp);
+        });
+    }
+
+    {
+        // The std::vector sink's reserve/commit path, which zero-fills every reservation, against appending with insert
+        auto ints = random_ints<int64_t>(N, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), eng);
+        for (auto& x : ints) x >>= eng() % 64;
+        std::vector<double> reals(1 << 16);
+        for (auto& x : reals) random(x, eng);
+
+        std::vector<char> buf;
+        const auto insert = [&buf](const char* bytes, size_t nbytes) {buf.insert(end(buf), bytes, bytes + nbytes);};
+        auto out = sink(buf);
+        for (const int64_t x : ints) serialize(out, x);
+        const size_t ints_bytes = buf.size();
+
+        suite.run("vector sink int scalars / reserve", ints_bytes, N, [&] {
+            buf.clear();
+            auto out = sink(buf);
+            for (const int64_t x : ints) serialize(out, x);
+            ankerl::nanobench::doNotOptimizeAway(buf.data());
+        });
+
+        suite.run("vector sink int scalars / insert", ints_bytes, N, [&] {
+            buf.clear();
+            auto out = insert;
+            for (const int64_t x : ints) serialize(out, x);
+            ankerl::nanobench::doNotOptimizeAway(buf.data());
+        });
+
+        suite.run("vector sink float64 array / reserve", 5 + 9 * reals.size(), reals.size(), [&] {
+            buf.clear();
+            auto out = sink(buf);
+            serialize(out, reals);
+            ankerl::nanobench::doNotOptimizeAway(buf.data());
+        });
+
+        suite.run("vector sink float64 array / insert", 5 + 9 * reals.size(), reals.size(), [&] {
+            buf.clear();
+            auto out = insert;
+            serialize(out, reals);
+            ankerl::nanobench::doNotOptimizeAway(buf.data());
+        });
+    }
+
+    {
+        // value pack/unpack against msgpack-c's own DOM (msgpack::object)
+        std::vector<msgpackcpp::value> docs;
+        for (size_t i = 0 ; i < 100 ; ++i)
+        {
+            docs.push_back({
+                {"pi", 3.141},
+                {"happy", true},
+                {"name", random_string(8, eng)},
+                {"nothing", nullptr},
+                {"answer", {{"everything", (int64_t)eng()}}},
+                {"list", {1, 0, 2}},
+                {"object", {{"currency", "USD"}, {"value", 42.99}}}
+            });
+        }
+        const msgpackcpp::value jv(std::move(docs));
+
+        std::vector<char> buf0;
+        auto out0 = sink(buf0);
+        jv.pack(out0);
+
+        msgpack::object_handle oh = msgpack::unpack(buf0.data(), buf0.size());
+        std::vector<char> buf1;
+
+        suite.run("value / msgpackcpp::pack", buf0.size(), 100, [&] {
+            buf0.clear();
+            auto out = sink(buf0);
+            jv.pack(out);
+            ankerl::nanobench::doNotOptimizeAway(buf0.data());
+        });
+
+        suite.run("value / msgpack_c::pack", buf0.size(), 100, [&] {
+            buf1.clear();
+            vector_sink out(buf1);
+            msgpack::pack(out, oh.get());
+            ankerl::nanobench::doNotOptimizeAway(buf1.data());
+        });
+
+        suite.run("value / msgpackcpp::unpack", buf0.size(), 100, [&] {
+            auto in = source(buf0);
+            auto tmp = msgpackcpp::unpack(in);
+            ankerl::nanobench::doNotOptimizeAway(tmp);
+        });
+
+        suite.run("value / msgpack_c::unpack", buf0.size(), 100, [&] {
+            msgpack::object_handle tmp = msgpack::unpack(buf0.data(), buf0.size());
+            ankerl::nanobench::doNotOptimizeAway(tmp);
+        });
+    }
+
+    suite.report();
+}
@@ -0,0 +1,506 @@
+#define ANKERL_NANOBENCH_IMPLEMENT
+#include <string_view>
+#include <nlohmann/json.hpp>
+#include "common.h"
+
+// msgpackcpp::value against nlohmann::json and msgpack-c's msgpack::object as DOM baselines.
+// Command line: see bench_suite
+
+using msgpackcpp::value;
+using msgpackcpp::key_interner;
+using nlohmann::json;
+
+//----------------------------------------------------------------------------------------------------------------
+
+// msgpack-c objects are immutable views allocated in a zone, so documents are assembled by hand
+msgpack::object make_map(msgpack::zone& z, std::initializer_list<std::pair<std::string_view, msgpack::object>> kvs)
+{
+    msgpack::object o;
+    o.type          = msgpack::type::MAP;
+    o.via.map.size  = uint32_t(kvs.size());
+    o.via.map.ptr   = static_cast<msgpack::object_kv*>(z.allocate_align(sizeof(msgpack::object_kv) * kvs.size()));
+    msgpack::object_kv* p = o.via.map.ptr;
+    for (const auto& [k, v] : kvs)
+    {
+        p->key = msgpack::object(k, z);
+        p->val = v;
+        ++p;
+    }
+    return o;
+}
+
+msgpack::object make_array(msgpack::zone& z, std::initializer_list<msgpack::object> elems)
+{
+    msgpack::object o;
+    o.type            = msgpack::type::ARRAY;
+    o.via.array.size  = uint32_t(elems.size());
+    o.via.array.ptr   = static_cast<msgpack::object*>(z.allocate_align(sizeof(msgpack::object) * elems.size()));
+    std::copy(begin(elems), end(elems), o.via.array.ptr);
+    return o;
+}
+
+// msgpack::object has no key lookup: maps are scanned linearly
+const msgpack::object& find_key(const msgpack::object& o, std::string_view key)
+{
+    const msgpack::object_kv* p = o.via.map.ptr;
+    const msgpack::object_kv* e = p + o.via.map.size;
+    for (; p != e ; ++p)
+        if (std::string_view(p->key.via.str.ptr, p->key.via.str.size) == key)
+            return p->val;
+    throw std::out_of_range("key");
+}
+
+//----------------------------------------------------------------------------------------------------------------
+
+value make_value(const std::string& name, int64_t answer)
+{
+    return {
+        {"pi", 3.141},
+        {"happy", true},
+        {"name", name},
+        {"nothing", nullptr},
+        {"answer", {{"everything", answer}}},
+        {"list", {1, 0, 2}},
+        {"object", {{"currency", "USD"}, {"value", 42.99}}}
+    };
+}
+
+json make_json(const std::string& name, int64_t answer)
+{
+    return {
+        {"pi", 3.141},
+        {"happy", true},
+        {"name", name},
+        {"nothing", nullptr},
+        {"answer", {{"everything", answer}}},
+        {"list", {1, 0, 2}},
+        {"object", {{"currency", "USD"}, {"value", 42.99}}}
+    };
+}
+
+msgpack::object make_object(msgpack::zone& z, const std::string& name, int64_t answer)
+{
+    return make_map(z, {
+        {"pi", msgpack::object(3.141)},
+        {"happy", msgpack::object(true)},
+        {"name", msgpack::object(name, z)},
+        {"nothing", msgpack::object()},
+        {"answer", make_map(z, {{"everything", msgpack::object(answer)}})},
+        {"list", make_array(z, {msgpack::object(1), msgpack::object(0), msgpack::object(2)})},
+        {"object", make_map(z, {{"currency", msgpack::object("USD", z)}, {"value", msgpack::object(42.99)}})}
+    });
+}
+
+//----------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bench_suite suite(argc, argv, "msgpackcpp::value");
+    auto        eng = make_engine();
+
+    const std::string name = "Niels";
+    const int64_t     answer = -42;
+
+    // Build one document from an initializer list
+    {
+        std::vector<char> buf;
+        auto out = sink(buf);
+        make_value(name, answer).pack(out);
+
+        suite.run("build / msgpackcpp::value", buf.size(), 1, [&] {
+            value v = make_value(name, answer);
+            ankerl::nanobench::doNotOptimizeAway(v);
+        });
+
+        suite.run("build / nlohmann::json", buf.size(), 1, [&] {
+            json j = make_json(name, answer);
+            ankerl::nanobench::doNotOptimizeAway(j);
+        });
+
+        suite.run("build / msgpack_c::object", buf.size(), 1, [&] {
+            msgpack::zone z;
+            msgpack::object o = make_object(z, name, answer);
+            ankerl::nanobench::doNotOptimizeAway(o);
+        });
+    }
+
+    // An array of documents for pack, unpack, copy and move
+    const size_t ndocs = 100;
+    std::vector<value> vdocs;
+    json               jdocs = json::array();
+    for (size_t i = 0 ; i < ndocs ; ++i)
+    {
+        const std::string n = "name_" + std::to_string(i);
+        const int64_t     a = int64_t(eng());
+        vdocs.push_back(make_value(n, a));
+        jdocs.push_back(make_json(n, a));
+    }
+    value docs(std::move(vdocs));
+
+    std::vector<char> buf0;
+    auto out0 = sink(buf0);
+    docs.pack(out0);
+    msgpack::object_handle oh = msgpack::unpack(buf0.data(), buf0.size());
+
+    {
+        std::vector<char>    buf1;
+        std::vector<uint8_t> buf2;
+
+        suite.run("pack / msgpackcpp::value", buf0.size(), ndocs, [&] {
+            buf1.clear();
+            auto out = sink(buf1);
+            docs.pack(out);
+            ankerl::nanobench::doNotOptimizeAway(buf1.data());
+        });
+
+        suite.run("pack / nlohmann::json", buf0.size(), ndocs, [&] {
+            buf2.clear();
+            json::to_msgpack(jdocs, buf2);
+            ankerl::nanobench::doNotOptimizeAway(buf2.data());
+        });
+
+        suite.run("pack / msgpack_c::object", buf0.size(), ndocs, [&] {
+            buf1.clear();
+            vector_sink out(buf1);
+            msgpack::pack(out, oh.get());
+            ankerl::nanobench::doNotOptimizeAway(buf1.data());
+        });
+    }
+
+    {
+        suite.run("unpack / msgpackcpp::value", buf0.size(), ndocs, [&] {
+            auto  in = source(buf0);
+            value v  = msgpackcpp::unpack(in);
+            ankerl::nanobench::doNotOptimizeAway(v);
+        });
+
+        suite.run("unpack / nlohmann::json", buf0.size(), ndocs, [&] {
+            json j = json::from_msgpack(begin(buf0), end(buf0));
+            ankerl::nanobench::doNotOptimizeAway(j);
+        });
+
+        suite.run("unpack / msgpack_c::object", buf0.size(), ndocs, [&] {
+            msgpack::object_handle tmp = msgpack::unpack(buf0.data(), buf0.size());
+            ankerl::nanobench::doNotOptimizeAway(tmp);
+        });
+    }
+
+    // A large array of small scalars, where the size of a node dominates
+    {
+        const size_t       nvalues = 1000000;
+        std::vector<value> values;
+        for (size_t i = 0 ; i < nvalues ; ++i)
+            values.push_back(i % 2 ? value(int64_t(eng() % 1000)) : value(double(i) * 0.5));
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        value(std::move(values)).pack(out);
+
+        suite.run("unpack scalars / msgpackcpp::value", buf.size(), nvalues, [&] {
+            auto  in = source(buf);
+            value v  = msgpackcpp::unpack(in);
+            ankerl::nanobench::doNotOptimizeAway(v);
+        });
+
+        suite.run("unpack scalars / nlohmann::json", buf.size(), nvalues, [&] {
+            json j = json::from_msgpack(begin(buf), end(buf));
+            ankerl::nanobench::doNotOptimizeAway(j);
+        });
+    }
+
+    // Homogeneous numeric arrays, as generic and as typed arrays
+    {
+        const size_t         nvalues = 1000000;
+        std::vector<double>  f64(nvalues);
+        std::vector<int64_t> i64(nvalues);
+        for (size_t i = 0 ; i < nvalues ; ++i)
+        {
+            f64[i] = double(eng()) / 3.0;
+            i64[i] = int64_t(eng() % 100000) - 50000;
+        }
+
+        msgpackcpp::unpack_options typed;
+        typed.typed_arrays = true;
+
+        std::vector<char> buf_f64, buf_i64;
+        auto out_f64 = sink(buf_f64);
+        auto out_i64 = sink(buf_i64);
+        msgpackcpp::serialize(out_f64, f64);
+        msgpackcpp::serialize(out_i64, i64);
+
+        for (const auto* buf : {&buf_f64, &buf_i64})
+        {
+            const std::string type = buf == &buf_f64 ? "f64" : "i64";
+
+            suite.run("unpack " + type + " array / msgpackcpp::value", buf->size(), nvalues, [&] {
+                auto  in = source(*buf);
+                value v  = msgpackcpp::unpack(in);
+                ankerl::nanobench::doNotOptimizeAway(v);
+            });
+
+            suite.run("unpack " + type + " array typed / msgpackcpp::value", buf->size(), nvalues, [&] {
+                auto  in = source(*buf);
+                value v  = msgpackcpp::unpack(in, typed);
+                ankerl::nanobench::doNotOptimizeAway(v);
+            });
+
+            auto        in = source(*buf);
+            const value v  = msgpackcpp::unpack(in, typed);
+            std::vector<char> out_buf;
+            suite.run("pack " + type + " array typed / msgpackcpp::value", buf->size(), nvalues, [&] {
+                out_buf.clear();
+                auto out = sink(out_buf);
+                v.pack(out);
+                ankerl::nanobench::doNotOptimizeAway(out_buf.data());
+            });
+        }
+    }
+
+    // Records whose field names are too long to be stored inline, with and without interning
+    {
+        const std::vector<std::string> fields = {"sensor_identifier", "temperature_celsius", "relative_humidity",
+                                                 "measurement_timestamp", "firmware_revision"};
+        const size_t nrecords = 1000;
+        std::vector<value> records;
+        for (size_t i = 0 ; i < nrecords ; ++i)
+        {
+            std::map<std::string, value> r;
+            for (const auto& f : fields)
+                r[f] = value(int64_t(eng() % 100000));
+            records.push_back(value(r));
+        }
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        value(std::move(records)).pack(out);
+
+        suite.run("unpack records / msgpackcpp::value", buf.size(), nrecords, [&] {
+            auto  in = source(buf);
+            value v  = msgpackcpp::unpack(in);
+            ankerl::nanobench::doNotOptimizeAway(v);
+        });
+
+        key_interner keys;
+        suite.run("unpack records interned / msgpackcpp::value", buf.size(), nrecords, [&] {
+            auto  in = source(buf);
+            value v  = msgpackcpp::unpack(in, keys);
+            ankerl::nanobench::doNotOptimizeAway(v);
+        });
+
+        suite.run("unpack records / nlohmann::json", buf.size(), nrecords, [&] {
+            json j = json::from_msgpack(begin(buf), end(buf));
+            ankerl::nanobench::doNotOptimizeAway(j);
+        });
+    }
+
+    // A proxy reading the envelope of a message and forwarding its payload
+    {
+        std::vector<value> payload;
+        for (int i = 0 ; i < 200 ; ++i)
+            payload.push_back(make_value("payload", i));
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        value({{"route", "telemetry"}, {"seq", 42}, {"payload", std::move(payload)}}).pack(out);
+
+        std::vector<char> fwd;
+        const auto forward = [&](const msgpackcpp::unpack_options& opts) {
+            auto  in = source(buf);
+            value v  = msgpackcpp::unpack(in, opts);
+            fwd.clear();
+            auto out2 = sink(fwd);
+            if (v.at("route").as_str() == "telemetry")
+                v.at("payload").pack(out2);
+            ankerl::nanobench::doNotOptimizeAway(fwd);
+        };
+
+        msgpackcpp::unpack_options lazy;
+        lazy.lazy = true;
+        suite.run("forward envelope / msgpackcpp::value", buf.size(), 1, [&] {forward({});});
+        suite.run("forward envelope lazy / msgpackcpp::value", buf.size(), 1, [&] {forward(lazy);});
+    }
+
+    // A large state document re-published after changing one leaf
+    {
+        const size_t nrecords = 10000;
+        value state;
+        for (size_t i = 0 ; i < nrecords ; ++i)
+        {
+            value& rec = state["record" + std::to_string(i)];
+            rec["id"]   = value(i);
+            rec["list"] = value(std::vector<value>(90, value(1000000)));
+        }
+
+        std::vector<char> buf;
+        auto    out = sink(buf);
+        int64_t seq{0};
+        state.pack(out);
+        const size_t nbytes = buf.size();
+
+        suite.run("publish / msgpackcpp::value", nbytes, 1, [&] {
+            state["record42"]["id"] = value(++seq);
+            buf.clear();
+            state.pack(out);
+            ankerl::nanobench::doNotOptimizeAway(buf);
+        });
+
+        msgpackcpp::cached_value cached(state);
+        suite.run("publish cached / msgpackcpp::value", nbytes, 1, [&] {
+            cached.edit({"record42", "id"}) = value(++seq);
+            buf.clear();
+            cached.pack(out);
+            ankerl::nanobench::doNotOptimizeAway(buf);
+        });
+    }
+
+    {
+        suite.run("copy / msgpackcpp::value", buf0.size(), ndocs, [&] {
+            value v = docs;
+            ankerl::nanobench::doNotOptimizeAway(v);
+        });
+
+        suite.run("copy / nlohmann::json", buf0.size(), ndocs, [&] {
+            json j = jdocs;
+            ankerl::nanobench::doNotOptimizeAway(j);
+        });
+
+        suite.run("copy / msgpack_c::object", buf0.size(), ndocs, [&] {
+            msgpack::object_handle tmp = msgpack::clone(oh.get());
+            ankerl::nanobench::doNotOptimizeAway(tmp);
+        });
+    }
+
+    {
+        // Moved back and forth so that nothing is freed inside the loop
+        value                   v;
+        json                    j;
+        msgpack::object_handle  h;
+
+        suite.run("move / msgpackcpp::value", buf0.size(), ndocs, [&] {
+            v    = std::move(docs);
+            docs = std::move(v);
+            ankerl::nanobench::doNotOptimizeAway(docs);
+        });
+
+        suite.run("move / nlohmann::json", buf0.size(), ndocs, [&] {
+            j     = std::move(jdocs);
+            jdocs = std::move(j);
+            ankerl::nanobench::doNotOptimizeAway(jdocs);
+        });
+
+        suite.run("move / msgpack_c::object", buf0.size(), ndocs, [&] {
+            h  = std::move(oh);
+            oh = std::move(h);
+            ankerl::nanobench::doNotOptimizeAway(oh);
+        });
+    }
+
+    {
+        const value docs2 = docs;
+        const json  jdocs2 = jdocs;
+
+        suite.run("compare / msgpackcpp::value", buf0.size(), ndocs, [&] {
+            ankerl::nanobench::doNotOptimizeAway(docs == docs2);
+        });
+
+        suite.run("compare / nlohmann::json", buf0.size(), ndocs, [&] {
+            ankerl::nanobench::doNotOptimizeAway(jdocs == jdocs2);
+        });
+
+        suite.run("hash / msgpackcpp::value", buf0.size(), ndocs, [&] {
+            ankerl::nanobench::doNotOptimizeAway(msgpackcpp::hash(docs));
+        });
+
+        suite.run("hash / nlohmann::json", buf0.size(), ndocs, [&] {
+            ankerl::nanobench::doNotOptimizeAway(std::hash<json>{}(jdocs));
+        });
+    }
+
+    // Lookups of every key of a wide object
+    {
+        const size_t             nkeys = 1000;
+        std::vector<std::string> keys;
+        std::map<std::string, value> vm;
+        json                     jm = json::object();
+        for (size_t i = 0 ; i < nkeys ; ++i)
+        {
+            keys.push_back("key_" + std::to_string(i));
+            vm[keys.back()] = value(int64_t(i));
+            jm[keys.back()] = int64_t(i);
+        }
+        value vwide(std::move(vm));
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        vwide.pack(out);
+        msgpack::object_handle owide = msgpack::unpack(buf.data(), buf.size());
+
+        suite.run("wide at() / msgpackcpp::value", buf.size(), nkeys, [&] {
+            int64_t sum{0};
+            for (const auto& k : keys) sum += std::as_const(vwide).at(k).as_int64();
+            ankerl::nanobench::doNotOptimizeAway(sum);
+        });
+
+        suite.run("wide operator[] / msgpackcpp::value", buf.size(), nkeys, [&] {
+            int64_t sum{0};
+            for (const auto& k : keys) sum += vwide[k].as_int64();
+            ankerl::nanobench::doNotOptimizeAway(sum);
+        });
+
+        suite.run("wide at() / nlohmann::json", buf.size(), nkeys, [&] {
+            int64_t sum{0};
+            for (const auto& k : keys) sum += std::as_const(jm).at(k).get<int64_t>();
+            ankerl::nanobench::doNotOptimizeAway(sum);
+        });
+
+        suite.run("wide operator[] / nlohmann::json", buf.size(), nkeys, [&] {
+            int64_t sum{0};
+            for (const auto& k : keys) sum += jm[k].get<int64_t>();
+            ankerl::nanobench::doNotOptimizeAway(sum);
+        });
+
+        suite.run("wide scan / msgpack_c::object", buf.size(), nkeys, [&] {
+            int64_t sum{0};
+            for (const auto& k : keys) sum += find_key(owide.get(), k).via.i64;
+            ankerl::nanobench::doNotOptimizeAway(sum);
+        });
+    }
+
+    // Lookup of the innermost value of a deeply nested object
+    {
+        const size_t depth = 64;
+        value vdeep = value(int64_t(1));
+        json  jdeep = 1;
+        for (size_t i = 0 ; i < depth ; ++i)
+        {
+            vdeep = value(std::map<std::string, value>{{"child", std::move(vdeep)}});
+            jdeep = json{{"child", std::move(jdeep)}};
+        }
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        vdeep.pack(out);
+        msgpack::object_handle odeep = msgpack::unpack(buf.data(), buf.size());
+        const std::string child = "child";
+
+        suite.run("deep at() / msgpackcpp::value", buf.size(), depth, [&] {
+            const value* v = &vdeep;
+            for (size_t i = 0 ; i < depth ; ++i) v = &v->at(child);
+            ankerl::nanobench::doNotOptimizeAway(v->as_int64());
+        });
+
+        suite.run("deep at() / nlohmann::json", buf.size(), depth, [&] {
+            const json* j = &jdeep;
+            for (size_t i = 0 ; i < depth ; ++i) j = &j->at(child);
+            ankerl::nanobench::doNotOptimizeAway(j->get<int64_t>());
+        });
+
+        suite.run("deep scan / msgpack_c::object", buf.size(), depth, [&] {
+            const msgpack::object* o = &odeep.get();
+            for (size_t i = 0 ; i < depth ; ++i) o = &find_key(*o, child);
+            ankerl::nanobench::doNotOptimizeAway(o->via.i64);
+        });
+    }
+
+    suite.report();
+}
@@ -12,9 +12,15 @@
 #include <vector>
 #include <array>
 #include <map>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
 #include <variant>
 #include <system_error>
-#if __cpp_lib_bit_cast
+#if __cpp_lib_bit_cast || __cpp_lib_bitops
 #include <bit>
 #endif
 #if __cpp_concepts
@@ -23,12 +29,225 @@
 
 //----------------------------------------------------------------------------------------------------------------
 
+namespace msgpackcpp
+{
+    // Optional capabilities of sinks and sources backed by contiguous memory:
+    //  - sink:   char* reserve(size_t n) returns room for at least n bytes, commit(size_t k) appends the first k of them (k <= n).
+    //            Encoders may scribble over all n reserved bytes.
+    //  - source: const char* data() and size_t remaining() describe the unread bytes, advance(size_t n) consumes n of them.
+    // (De)serialization detects them at compile time and then encodes/decodes in place with one bounds check per object.
+
+    template<class S, class = void>
+    struct is_contiguous_sink : std::false_type {};
+
+    template<class S>
+    struct is_contiguous_sink<S, std::void_t<decltype(static_cast<char*>(std::declval<S&>().reserve(std::size_t{}))),
+                                             decltype(std::declval<S&>().commit(std::size_t{}))>> : std::true_type {};
+
+    template<class S, class = void>
+    struct is_contiguous_source : std::false_type {};
+
+    template<class S>
+    struct is_contiguous_source<S, std::void_t<decltype(static_cast<const char*>(std::declval<S&>().data())),
+                                               decltype(static_cast<std::size_t>(std::declval<S&>().remaining())),
+                                               decltype(std::declval<S&>().advance(std::size_t{}))>> : std::true_type {};
+
+    template<class S>
+    constexpr bool is_contiguous_sink_v = is_contiguous_sink<S>::value;
+
+    template<class S>
+    constexpr bool is_contiguous_source_v = is_contiguous_source<S>::value;
+
+    // Sources declaring `static constexpr bool trusted = true` promise well-formed input which fits in
+    // their memory: decoders then skip bounds checks and format validation (bad input is undefined behaviour).
+    template<class S, class = void>
+    struct is_trusted_source : std::false_type {};
+
+    template<class S>
+    struct is_trusted_source<S, std::enable_if_t<S::trusted>> : std::true_type {};
+
+    template<class S>
+    constexpr bool is_trusted_source_v = is_trusted_source<S>::value;
+
+    // Encoding policies. A sink selects one with a nested `encoding_policy` type, e.g. with_policy<fixed_encoding>(out).
+    //  - minimal_encoding: smallest format for every value (default).
+    //  - fixed_encoding:   integers use the width of their C++ type and str/bin/array/map headers are 32-bit, so offsets
+    //                      don't depend on values and pre-encoded messages can be patched in place.
+    //  - canonical_encoding: minimal_encoding, plus every NaN is written as the default quiet NaN and unordered maps
+    //                      are written in key order, so that equal data always encode to the same bytes.
+    // Floats are always encoded with their own fixed format.
+    struct minimal_encoding {};
+    struct fixed_encoding {};
+    struct canonical_encoding {};
+
+    template<class S, class = void>
+    struct sink_encoding_policy { using type = minimal_encoding; };
+
+    template<class S>
+    struct sink_encoding_policy<S, std::void_t<typename S::encoding_policy>> { using type = typename S::encoding_policy; };
+
+    template<class S>
+    using sink_encoding_policy_t = typename sink_encoding_policy<S>::type;
+
+    template<class S>
+    constexpr bool uses_fixed_encoding = std::is_same_v<sink_encoding_policy_t<S>, fixed_encoding>;
+
+    template<class S>
+    constexpr bool uses_canonical_encoding = std::is_same_v<sink_encoding_policy_t<S>, canonical_encoding>;
+
+    // Sinks and sources may expose `std::size_t position() const`, the number of bytes written or read so far.
+    template<class S, class = void>
+    struct has_position : std::false_type {};
+
+    template<class S>
+    struct has_position<S, std::void_t<decltype(static_cast<std::size_t>(std::declval<const S&>().position()))>> : std::true_type {};
+
+    constexpr std::size_t trace_npos = static_cast<std::size_t>(-1);
+
+    template<class S>
+    std::size_t position_of(const S& s) noexcept
+    {
+        if constexpr (has_position<S>::value)
+            return s.position();
+        else
+            return trace_npos;
+    }
+}
+
+//----------------------------------------------------------------------------------------------------------------
+
+// Tracing hooks. Compiled out unless MSGPACK_ENABLE_TRACING is defined, consistently in every translation unit of the
+// program. When enabled, the tracer installed on the calling thread (trace_guard) is notified on entry and exit of
+// the (de)serialization of arrays, maps, tuples, Boost.Describe structs and each of their members, and value arrays/maps.
+
+#ifdef MSGPACK_ENABLE_TRACING
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace msgpackcpp
+{
+    enum trace_kind : uint8_t
+    {
+        TRACE_ARRAY,
+        TRACE_MAP,
+        TRACE_TUPLE,
+        TRACE_STRUCT,
+        TRACE_MEMBER
+    };
+
+    struct trace_event
+    {
+        bool        serializing{};
+        trace_kind  kind{};
+        const char* name{};             // member name for TRACE_MEMBER, "value" for value arrays and maps, otherwise null
+        uint32_t    count{};            // elements, entries or members. Only known on exit when deserializing
+        std::size_t offset{trace_npos}; // position() of the sink/source on entry, if it has one
+        uint64_t    start{};            // trace_clock() on entry
+        uint64_t    cycles{};           // elapsed trace_clock() ticks, on exit
+    };
+
+    // Implement and install with trace_guard to receive events, e.g. to fire USDT probes. Must not throw.
+    class tracer
+    {
+    public:
+        virtual ~tracer() = default;
+        virtual void enter(const trace_event&) {}
+        virtual void exit(const trace_event&)  {}
+    };
+
+    inline tracer*& thread_tracer() noexcept
+    {
+        static thread_local tracer* current{nullptr};
+        return current;
+    }
+
+    // Installs a tracer on the calling thread for the lifetime of the guard
+    class trace_guard
+    {
+    private:
+        tracer* previous{};
+
+    public:
+        explicit trace_guard(tracer& t) noexcept : previous{thread_tracer()} { thread_tracer() = &t; }
+        ~trace_guard() { thread_tracer() = previous; }
+        trace_guard(const trace_guard&)            = delete;
+        trace_guard& operator=(const trace_guard&) = delete;
+    };
+
+    // TSC ticks on x86, nanoseconds elsewhere
+    inline uint64_t trace_clock() noexcept
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    class trace_scope
+    {
+    private:
+        tracer*     t{};
+        trace_event ev;
+
+    public:
+        trace_scope(bool serializing, trace_kind kind, const char* name, std::size_t count, std::size_t offset) noexcept
+        :   t{thread_tracer()}
+        {
+            if (t)
+            {
+                ev = {serializing, kind, name, static_cast<uint32_t>(count), offset, trace_clock(), 0};
+                t->enter(ev);
+            }
+        }
+
+        ~trace_scope()
+        {
+            if (t)
+            {
+                ev.cycles = trace_clock() - ev.start;
+                t->exit(ev);
+            }
+        }
+
+        void count(uint32_t n) noexcept { ev.count = n; }
+
+        trace_scope(const trace_scope&)            = delete;
+        trace_scope& operator=(const trace_scope&) = delete;
+    };
+}
+
+// MSGPACK_TRACE_MARK records the offset used by a later MSGPACK_TRACE_SCOPE_AT, for when the header is read first
+#define MSGPACK_TRACE_SCOPE(serializing, kind, name, count, io) \
+    msgpackcpp::trace_scope msgpack_trace_scope_{serializing, msgpackcpp::kind, name, count, msgpackcpp::position_of(io)}
+#define MSGPACK_TRACE_MARK(io) \
+    const std::size_t msgpack_trace_offset_ = msgpackcpp::position_of(io)
+#define MSGPACK_TRACE_SCOPE_AT(serializing, kind, name, count) \
+    msgpackcpp::trace_scope msgpack_trace_scope_{serializing, msgpackcpp::kind, name, count, msgpack_trace_offset_}
+#define MSGPACK_TRACE_COUNT(n) msgpack_trace_scope_.count(n)
+
+#else
+#define MSGPACK_TRACE_SCOPE(serializing, kind, name, count, io)
+#define MSGPACK_TRACE_MARK(io)
+#define MSGPACK_TRACE_SCOPE_AT(serializing, kind, name, count)
+#define MSGPACK_TRACE_COUNT(n)
+#endif
+
 #if __cpp_concepts
 
 namespace msgpackcpp
 {
     template<class F> concept sink_type   = std::invocable<F, const char*, std::size_t>;
     template<class F> concept source_type = std::invocable<F, char*, std::size_t>;
+
+    template<class F> concept contiguous_sink_type   = sink_type<F>   && is_contiguous_sink_v<F>;
+    template<class F> concept contiguous_source_type = source_type<F> && is_contiguous_source_v<F>;
 }
 
 #define SINK_TYPE   msgpackcpp::sink_type
@@ -90,6 +309,15 @@ namespace msgpackcpp
     template<class T>
     constexpr bool is_map_v = is_map<T>::value;
 
+    template<class T, class = void>
+    struct is_unordered_map : std::false_type {};
+
+    template<class T>
+    struct is_unordered_map<T, std::void_t<typename T::hasher>> : is_map<T> {};
+
+    template<class T>
+    constexpr bool is_unordered_map_v = is_unordered_map<T>::value;
+
 //----------------------------------------------------------------------------------------------------------------
 
     template<class T>
@@ -115,25 +343,350 @@ namespace msgpackcpp
 
 //----------------------------------------------------------------------------------------------------------------
 
+    // Upper bound on the number of bytes serialize() writes for a value of type T.
+    // Only defined (through a `value` member) for types whose encoding is bounded. Specialize it for your own types,
+    // for instance with max_encoded_str_size() for a string whose length is known to be limited.
+    template<class T, class = void>
+    struct max_encoded_size {};
+
+    template<class T, class = void>
+    struct has_max_encoded_size : std::false_type {};
+
+    template<class T>
+    struct has_max_encoded_size<T, std::void_t<decltype(max_encoded_size<T>::value)>> : std::true_type {};
+
+    template<class T>
+    constexpr bool has_max_encoded_size_v = has_max_encoded_size<std::remove_cv_t<T>>::value;
+
+    template<class T>
+    constexpr std::size_t max_encoded_size_v = max_encoded_size<std::remove_cv_t<T>>::value;
+
+    constexpr std::size_t max_encoded_str_size(std::size_t len)
+    {
+        return (len < 32 ? 1 : len < 256 ? 2 : len < 65536 ? 3 : 5) + len;
+    }
+
+    constexpr std::size_t max_encoded_bin_size(std::size_t len)
+    {
+        return (len < 256 ? 2 : len < 65536 ? 3 : 5) + len;
+    }
+
+    constexpr std::size_t encoded_array_header_size(std::size_t size)
+    {
+        return size < 16 ? 1 : size < 65536 ? 3 : 5;
+    }
+
+    constexpr std::size_t encoded_map_header_size(std::size_t size)
+    {
+        return encoded_array_header_size(size);
+    }
+
+    template<>
+    struct max_encoded_size<std::nullptr_t> : std::integral_constant<std::size_t, 1> {};
+
+    template<>
+    struct max_encoded_size<bool> : std::integral_constant<std::size_t, 1> {};
+
+    template<class Int>
+    struct max_encoded_size<Int, std::enable_if_t<std::is_integral_v<Int> && !std::is_same_v<Int, bool>>> 
+    : std::integral_constant<std::size_t, 1 + sizeof(Int)> {};
+
+    template<>
+    struct max_encoded_size<float> : std::integral_constant<std::size_t, 5> {};
+
+    template<>
+    struct max_encoded_size<double> : std::integral_constant<std::size_t, 9> {};
+
+    template<class Byte, std::size_t N>
+    struct max_encoded_size<std::array<Byte, N>, std::enable_if_t<is_binary_value_type<Byte>>>
+    : std::integral_constant<std::size_t, max_encoded_bin_size(N)> {};
+
+    template<class T, std::size_t N>
+    struct max_encoded_size<std::array<T, N>, std::enable_if_t<!is_binary_value_type<T> && has_max_encoded_size_v<T>>>
+    : std::integral_constant<std::size_t, encoded_array_header_size(N) + N * max_encoded_size_v<T>> {};
+
+    template<class... Args>
+    struct max_encoded_size<std::tuple<Args...>, std::enable_if_t<(has_max_encoded_size_v<Args> && ...)>>
+    : std::integral_constant<std::size_t, encoded_array_header_size(sizeof...(Args)) + (std::size_t{0} + ... + max_encoded_size_v<Args>)> {};
+
+    // Upper bound on the number of str, bin, array and map headers in the encoding of T. fixed_encoding writes each
+    // of them in 5 bytes, which max_encoded_size_for_v<T, fixed_encoding> adds to max_encoded_size_v<T>.
+    template<class T, class = void>
+    struct max_encoded_headers {};
+
+    template<class T, class = void>
+    struct has_max_encoded_headers : std::false_type {};
+
+    template<class T>
+    struct has_max_encoded_headers<T, std::void_t<decltype(max_encoded_headers<T>::value)>> : std::true_type {};
+
+    template<class T>
+    constexpr bool has_max_encoded_headers_v = has_max_encoded_headers<std::remove_cv_t<T>>::value;
+
+    template<class T>
+    constexpr std::size_t max_encoded_headers_v = max_encoded_headers<std::remove_cv_t<T>>::value;
+
+    template<class T>
+    struct max_encoded_headers<T, std::enable_if_t<std::is_arithmetic_v<T> || std::is_same_v<T, std::nullptr_t>>>
+    : std::integral_constant<std::size_t, 0> {};
+
+    template<class Byte, std::size_t N>
+    struct max_encoded_headers<std::array<Byte, N>, std::enable_if_t<is_binary_value_type<Byte>>>
+    : std::integral_constant<std::size_t, 1> {};
+
+    template<class T, std::size_t N>
+    struct max_encoded_headers<std::array<T, N>, std::enable_if_t<!is_binary_value_type<T> && has_max_encoded_headers_v<T>>>
+    : std::integral_constant<std::size_t, 1 + N * max_encoded_headers_v<T>> {};
+
+    template<class... Args>
+    struct max_encoded_headers<std::tuple<Args...>, std::enable_if_t<(has_max_encoded_headers_v<Args> && ...)>>
+    : std::integral_constant<std::size_t, 1 + (std::size_t{0} + ... + max_encoded_headers_v<Args>)> {};
+
+    // Integers and floats already count at their full width, so only the headers grow under fixed_encoding
+    template<class T, class Policy>
+    constexpr std::size_t max_encoded_size_for()
+    {
+        if constexpr (std::is_same_v<Policy, fixed_encoding>)
+            return max_encoded_size_v<T> + 4 * max_encoded_headers_v<T>;
+        else
+            return max_encoded_size_v<T>;
+    }
+
+    template<class T, class Policy = minimal_encoding>
+    constexpr std::size_t max_encoded_size_for_v = max_encoded_size_for<T, Policy>();
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Map key of a value. Keys of up to 15 bytes are stored inline, longer ones in an immutable reference-counted
+    // block which copies share, as do all the keys a key_interner hands out for the same name.
+    class value_key
+    {
+    private:
+        struct block
+        {
+            std::atomic<uint32_t> refs;
+            uint32_t              size;
+            const char* data() const noexcept {return reinterpret_cast<const char*>(this + 1);}
+        };
+
+        static constexpr uint8_t heap_tag = 0xff;
+
+        // Inline: bytes, zero padded, and the size in the last byte. Heap: the block pointer and heap_tag.
+        char buf[16]{};
+
+        bool         on_heap()  const noexcept {return static_cast<uint8_t>(buf[15]) == heap_tag;}
+        const block* heap()     const noexcept;
+        void         retain()   const noexcept;
+        void         release()  noexcept;
+
+    public:
+        static constexpr std::size_t inline_capacity = 15;
+
+        value_key() = default;
+        value_key(std::string_view s);
+        value_key(const char* s)        : value_key(std::string_view(s)) {}
+        value_key(const std::string& s) : value_key(std::string_view(s)) {}
+        value_key(const value_key& other) noexcept;
+        value_key(value_key&& other) noexcept;
+        value_key& operator=(const value_key& other) noexcept;
+        value_key& operator=(value_key&& other) noexcept;
+        ~value_key();
+
+        const char*      data()      const noexcept;
+        std::size_t      size()      const noexcept;
+        bool             empty()     const noexcept {return size() == 0;}
+        std::string_view view()      const noexcept {return {data(), size()};}
+        std::string      str()       const          {return std::string(view());}
+        bool             is_inline() const noexcept {return !on_heap();}
+        std::size_t      use_count() const noexcept;    // owners of the heap block, 0 when inline
+        operator std::string_view()  const noexcept {return view();}
+
+        // Inline keys compare with two 8-byte loads, heap keys by pointer first
+        friend bool operator==(const value_key& a, const value_key& b) noexcept;
+        friend bool operator!=(const value_key& a, const value_key& b) noexcept {return !(a == b);}
+        friend bool operator< (const value_key& a, const value_key& b) noexcept;
+
+        template<class S>
+        using if_string = std::enable_if_t<std::is_convertible_v<const S&, std::string_view> && !std::is_same_v<S, value_key>, bool>;
+
+        template<class S, if_string<S> = true>
+        friend bool operator==(const value_key& a, const S& b) noexcept {return a.view() == std::string_view(b);}
+        template<class S, if_string<S> = true>
+        friend bool operator==(const S& a, const value_key& b) noexcept {return std::string_view(a) == b.view();}
+        template<class S, if_string<S> = true>
+        friend bool operator!=(const value_key& a, const S& b) noexcept {return a.view() != std::string_view(b);}
+        template<class S, if_string<S> = true>
+        friend bool operator!=(const S& a, const value_key& b) noexcept {return std::string_view(a) != b.view();}
+        template<class S, if_string<S> = true>
+        friend bool operator< (const value_key& a, const S& b) noexcept {return a.view() < std::string_view(b);}
+        template<class S, if_string<S> = true>
+        friend bool operator< (const S& a, const value_key& b) noexcept {return std::string_view(a) < b.view();}
+    };
+
+    // Shares the storage of long map keys between values. Not thread-safe: use one per thread, e.g. key_interner::local().
+    // The keys it hands out are safe to use from any thread. At most max_keys names are kept; further ones are not interned.
+    class key_interner
+    {
+    private:
+        std::unordered_map<std::string_view, value_key> keys;   // views into the keys' own blocks
+        std::size_t                                     max_keys{};
+
+    public:
+        explicit key_interner(std::size_t max_keys_ = 4096) : max_keys{max_keys_} {}
+
+        value_key   intern(std::string_view s);
+        std::size_t size() const noexcept {return keys.size();}
+        void        clear() noexcept      {keys.clear();}
+
+        static key_interner& local();
+    };
+
+    class value;
+    using value_map = std::map<value_key, value, std::less<>>;
+
+    // One step of a path into a value or an encoded buffer: a map key or an array index
+    struct path_element
+    {
+        std::string_view    key;
+        uint32_t            index{0};
+        bool                is_index{false};
+
+        path_element(std::string_view key_) : key{key_} {}
+        path_element(const char* key_) : key{key_} {}
+        path_element(const std::string& key_) : key{key_} {}
+
+        template<class Int, std::enable_if_t<std::is_integral_v<Int>, bool> = true>
+        path_element(Int index_) : index{static_cast<uint32_t>(index_)}, is_index{true} {}
+    };
+
+    using path = std::initializer_list<path_element>;
+
+    struct unpack_options
+    {
+        key_interner* keys{nullptr};        // interns map keys longer than value_key::inline_capacity
+        bool          typed_arrays{false};  // stores arrays of only integers or only floats as std::vector<int64_t>/std::vector<double>
+        bool          lazy{false};          // keeps nested arrays and maps encoded until they are first accessed. Const
+                                            // accesses decode once into the node and may be made from several threads.
+    };
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // 16 bytes: a tag, then a scalar, a string of up to 14 bytes or a pointer to an owned string, binary array, array or map.
     class value
     {
     private:
-        std::variant<std::nullptr_t,
-                     bool,
-                     int64_t,
-                     uint64_t,
-                     double,
-                     std::string,
-                     std::vector<char>,
-                     std::vector<value>,
-                     std::map<std::string, value>> val;
+        enum kind : uint8_t {NIL, BOOL, INT64, UINT64, REAL, SMALL_STR, STR, BIN, ARRAY, OBJECT, I64_ARRAY, F64_ARRAY, LAZY};
+
+        static constexpr std::size_t small_capacity = 14;
+
+        // All members start with the tag, which can therefore be read through any of them
+        struct tag_only  { kind tag; };
+        template<class T>
+        struct tagged    { kind tag; T v; };
+        struct small_str { kind tag; uint8_t size; char data[small_capacity]; };
+
+        // An array or map left encoded by a lazy unpack. Const accesses decode it into `decoded` once, non-const
+        // ones replace the node with its decoded value.
+        struct lazy_node
+        {
+            std::vector<char> bytes;        // the whole subtree, header included
+            unpack_options    opts;
+            kind              decodes_to;   // ARRAY, OBJECT, I64_ARRAY or F64_ARRAY
+            uint32_t          size;
+            mutable std::once_flag          once{};
+            mutable std::unique_ptr<value>  decoded{};
+        };
+
+        // Arrays and maps may keep their encoded bytes, see cached_value. An empty cache is dirty, and keeps
+        // its capacity for the next encoding.
+        template<class C>
+        struct cached_block : C
+        {
+            std::unique_ptr<std::vector<char>> encoded;
+
+            using C::C;
+            cached_block() = default;
+            explicit cached_block(C c) : C(std::move(c)) {}
+            cached_block(const cached_block& other) : C(other) {}   // copies start without a cache
+        };
+
+        using array_block  = cached_block<std::vector<value>>;
+        using object_block = cached_block<value_map>;
+
+        // Typed arrays keep a generic copy for the const as_array(), built on first use and published atomically
+        // so that concurrent readers share it. Non-const accesses drop it.
+        template<class T>
+        struct typed_block : std::vector<T>
+        {
+            mutable std::atomic<array_block*> generic{nullptr};
+
+            using std::vector<T>::vector;
+            typed_block() = default;
+            explicit typed_block(std::vector<T> v) : std::vector<T>(std::move(v)) {}
+            typed_block(const typed_block& other) : std::vector<T>(other) {}
+            ~typed_block() {delete generic.load();}
+        };
+
+        using i64_block = typed_block<int64_t>;
+        using f64_block = typed_block<double>;
+
+        // Smaller subtrees are re-encoded rather than cached
+        static constexpr std::size_t cache_threshold = 256;
+
+        union node
+        {
+            tag_only                    h;
+            tagged<bool>                b;
+            tagged<int64_t>             i;
+            tagged<uint64_t>            u;
+            tagged<double>              d;
+            small_str                   s;
+            tagged<std::string*>        str;
+            tagged<std::vector<char>*>  bin;
+            tagged<array_block*>        arr;
+            tagged<object_block*>       obj;
+            tagged<i64_block*>            i64s;
+            tagged<f64_block*>            f64s;
+            tagged<lazy_node*>            lazy;
+        } n{};
+
+        kind tag() const noexcept {return n.h.tag;}
+        kind decoded_tag() const noexcept {return tag() == LAZY ? n.lazy.v->decodes_to : tag();}
+        void expect(kind k) const;
+        void reset() noexcept;
+        void set_str(std::string_view v);
+        void copy_from(const value& other);
+        void make_generic_array();
+        std::unique_ptr<array_block> generic_copy() const;
+        const array_block& generic_view() const;
+        void drop_generic_view() noexcept;
+        void materialize();                 // replaces a lazy subtree with its decoded value
+        const value& resolved() const;      // *this, or the decoded value of a lazy subtree
+        static value decoded(const lazy_node& l);
+        void touch() noexcept;      // invalidates the cached encoding, before handing out a mutable reference
+        std::unique_ptr<std::vector<char>>* cache_slot() noexcept;
+        void drop_caches() noexcept;
+        void encode_composite(std::vector<char>& buf);
+        void encode_cached(std::vector<char>& buf);
+
+        friend class cached_value;
+
+        template<SOURCE_TYPE Source>
+        void unpack_(Source& in, const unpack_options& opts, bool defer);
+
+        template<SOURCE_TYPE Source>
+        void defer_(Source& in, const unpack_options& opts, const uint8_t format, const uint32_t size);
+
+        template<SOURCE_TYPE Source>
+        void unpack_array_(Source& in, const unpack_options& opts, const uint32_t size);
 
     public:
-        value()                             = default;
-        value(const value& ori)             = default;
-        value(value&& ori)                  = default;
-        value& operator=(const value& ori)  = default;
-        value& operator=(value&& ori)       = default;
+        value() = default;
+        value(const value& ori);
+        value(value&& ori) noexcept;
+        value& operator=(const value& ori);
+        value& operator=(value&& ori) noexcept;
+        ~value();
 
         value(std::nullptr_t);
         value(bool v);
@@ -152,7 +705,10 @@ namespace msgpackcpp
         value(std::string v);
         value(std::vector<char> v);
         value(std::vector<value> v);
-        value(std::map<std::string, value> v);
+        value(std::vector<int64_t> v);
+        value(std::vector<double> v);
+        value(value_map v);
+        value(const std::map<std::string, value>& v);
         value(std::initializer_list<value> v);
 
         size_t size() const noexcept;
@@ -165,6 +721,8 @@ namespace msgpackcpp
         bool is_binary()    const noexcept;
         bool is_array()     const noexcept;
         bool is_object()    const noexcept;
+        bool is_i64_array() const noexcept;
+        bool is_f64_array() const noexcept;
 
         auto as_bool()      const -> bool;
         auto as_bool()            -> bool&;
@@ -174,18 +732,22 @@ namespace msgpackcpp
         auto as_uint64()          -> uint64_t&;
         auto as_real()      const -> double;
         auto as_real()            -> double&;
-        auto as_str()       const -> const std::string&;
-        auto as_str()             -> std::string&;
+        auto as_str()       const -> std::string_view;  // not const std::string&: short strings are stored inline
+        auto as_str()             -> std::string&;      // moves a short string out of line
         auto as_bin()       const -> const std::vector<char>&;
         auto as_bin()             -> std::vector<char>&;
-        auto as_array()     const -> const std::vector<value>&;
-        auto as_array()           -> std::vector<value>&;
-        auto as_object()    const -> const std::map<std::string, value>&;
-        auto as_object()          -> std::map<std::string, value>&;
-
-        const value& at(const std::string& key) const;
-        value&       at(const std::string& key);
-        value&       operator[](const std::string& key);
+        auto as_array()     const -> const std::vector<value>&;     // throws for typed arrays
+        auto as_array()           -> std::vector<value>&;           // converts typed arrays
+        auto as_i64_array() const -> const std::vector<int64_t>&;
+        auto as_i64_array()       -> std::vector<int64_t>&;
+        auto as_f64_array() const -> const std::vector<double>&;
+        auto as_f64_array()       -> std::vector<double>&;
+        auto as_object()    const -> const value_map&;
+        auto as_object()          -> value_map&;
+
+        const value& at(std::string_view key) const;
+        value&       at(std::string_view key);
+        value&       operator[](std::string_view key);
 
         const value& operator[](size_t array_index) const;
         value&       operator[](size_t array_index);
@@ -195,6 +757,41 @@ namespace msgpackcpp
 
         template<SOURCE_TYPE Source>
         void unpack(Source& in);
+
+        // Map keys longer than value_key::inline_capacity are interned
+        template<SOURCE_TYPE Source>
+        void unpack(Source& in, key_interner& keys);
+
+        template<SOURCE_TYPE Source>
+        void unpack(Source& in, const unpack_options& opts);
+
+        // Equal when their canonical encodings are, e.g. int64 and uint64 of the same value, or a typed array and
+        // a generic one with the same elements. Neither side is encoded.
+        friend bool operator==(const value& a, const value& b);
+        friend bool operator!=(const value& a, const value& b) {return !(a == b);}
+    };
+
+    // Hash of the canonical encoding: equal values hash equally
+    uint64_t hash(const value& v);
+
+    // Owns a value and keeps the encoding of its large arrays and maps between calls to pack(), which then only
+    // re-encodes what was edited. Modifications go through edit(), which invalidates every node on the path.
+    // A reference returned by edit() must not be used after the next pack().
+    class cached_value
+    {
+    private:
+        value doc;
+
+    public:
+        cached_value() = default;
+        explicit cached_value(value v);
+
+        const value& get() const noexcept {return doc;}
+        value&       edit(path p = {});     // inserts missing map keys, throws std::out_of_range for array indices
+        value        release();
+
+        template<SINK_TYPE Sink>
+        void pack(Sink& out);
     };
 
 //----------------------------------------------------------------------------------------------------------------
@@ -302,6 +899,12 @@ namespace msgpackcpp
     template<SOURCE_TYPE Source, class... Args>
     void deserialize(Source& in, std::tuple<Args...>& tpl);
 
+//----------------------------------------------------------------------------------------------------------------
+
+    // Consumes the next object, including all of its children, without decoding it
+    template<SOURCE_TYPE Source>
+    void skip(Source& in);
+
 //----------------------------------------------------------------------------------------------------------------
 //----------------------------------------------------------------------------------------------------------------
 // DEFINITIONS
@@ -408,95 +1011,450 @@ namespace msgpackcpp
 
 //----------------------------------------------------------------------------------------------------------------
 
-    inline value::value(std::nullptr_t)        : val{nullptr} {}
-    inline value::value(bool v)                : val{v} {}
-    inline value::value(const char* v)         : val(std::string(v)) {}
-    inline value::value(std::string_view v)    : val(std::string(v)) {}
-    inline value::value(std::string v)         : val{std::move(v)} {}
-    inline value::value(std::vector<char> v)   : val{std::move(v)} {}
-    inline value::value(std::vector<value> v)  : val{std::move(v)} {}
-    inline value::value(std::map<std::string, value> v) : val{std::move(v)} {}
+    inline value_key::value_key(std::string_view s)
+    {
+        if (s.size() <= inline_capacity)
+        {
+            std::memcpy(buf, s.data(), s.size());
+            buf[15] = static_cast<char>(s.size());
+        }
+        else
+        {
+            if (s.size() > std::numeric_limits<uint32_t>::max())
+                throw std::system_error(BAD_SIZE);
+            void*  mem = ::operator new(sizeof(block) + s.size());
+            block* b   = new (mem) block{{1}, static_cast<uint32_t>(s.size())};
+            std::memcpy(const_cast<char*>(b->data()), s.data(), s.size());
+            std::memcpy(buf, &b, sizeof(b));
+            buf[15] = static_cast<char>(heap_tag);
+        }
+    }
 
-    template<class Int, check_sint<Int>>
-    inline value::value(Int v) : val{static_cast<int64_t>(v)} {}
+    inline value_key::value_key(const value_key& other) noexcept
+    {
+        std::memcpy(buf, other.buf, sizeof(buf));
+        retain();
+    }
 
-    template<class UInt, check_uint<UInt>>
-    inline value::value(UInt v) : val{static_cast<uint64_t>(v)} {}
+    inline value_key::value_key(value_key&& other) noexcept
+    {
+        std::memcpy(buf, other.buf, sizeof(buf));
+        std::memset(other.buf, 0, sizeof(other.buf));
+    }
 
-    template<class Real, check_float<Real>>
-    inline value::value(Real v) : val{static_cast<double>(v)} {}
+    inline value_key& value_key::operator=(const value_key& other) noexcept
+    {
+        other.retain();
+        release();
+        std::memcpy(buf, other.buf, sizeof(buf));
+        return *this;
+    }
 
-    inline value::value(std::initializer_list<value> v)
+    inline value_key& value_key::operator=(value_key&& other) noexcept
     {
-        const bool is_object = std::all_of(begin(v), end(v), [](const auto& el) {
-            return el.is_array() && el.size() == 2 && el[0].is_str();
-        });
+        if (this != &other)
+        {
+            release();
+            std::memcpy(buf, other.buf, sizeof(buf));
+            std::memset(other.buf, 0, sizeof(other.buf));
+        }
+        return *this;
+    }
 
-        if (is_object)
+    inline value_key::~value_key()
+    {
+        release();
+    }
+
+    inline auto value_key::heap() const noexcept -> const block*
+    {
+        const block* b{};
+        std::memcpy(&b, buf, sizeof(b));
+        return b;
+    }
+
+    inline void value_key::retain() const noexcept
+    {
+        if (on_heap())
+            const_cast<block*>(heap())->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void value_key::release() noexcept
+    {
+        if (on_heap())
         {
-            auto& map = val.emplace<std::map<std::string, value>>();
-            for (const auto& el : v)
-                map.emplace(el[0].as_str(), el[1]);
+            block* b = const_cast<block*>(heap());
+            if (b->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                b->~block();
+                ::operator delete(b);
+            }
+            std::memset(buf, 0, sizeof(buf));
         }
-        else
-            val.emplace<std::vector<value>>(v);
     }
 
-    inline size_t value::size() const noexcept
+    inline const char* value_key::data() const noexcept
     {
-        return std::visit(overloaded{
-            [&](const std::vector<char>& v)             {return v.size();},
-            [&](const std::vector<value>& v)            {return v.size();},
-            [&](const std::map<std::string, value>& v)  {return v.size();},
-            [&](std::nullptr_t)                         {return (size_t)0;},
-            [&](const auto&)                            {return (size_t)1;}
-        }, val);
-    }
-
-    inline bool value::is_null()   const noexcept {return std::holds_alternative<std::nullptr_t>(val);}
-    inline bool value::is_bool()   const noexcept {return std::holds_alternative<bool>(val);}
-    inline bool value::is_int()    const noexcept {return std::holds_alternative<int64_t>(val) || std::holds_alternative<uint64_t>(val);}
-    inline bool value::is_real()   const noexcept {return std::holds_alternative<double>(val);}
-    inline bool value::is_str()    const noexcept {return std::holds_alternative<std::string>(val);}
-    inline bool value::is_binary() const noexcept {return std::holds_alternative<std::vector<char>>(val);}
-    inline bool value::is_array()  const noexcept {return std::holds_alternative<std::vector<value>>(val);}
-    inline bool value::is_object() const noexcept {return std::holds_alternative<std::map<std::string, value>>(val);}
-
-    inline auto value::as_bool()      const -> bool                        {return std::get<bool>(val);}
-    inline auto value::as_bool()            -> bool&                       {return std::get<bool>(val);}
-    inline auto value::as_int64()     const -> int64_t                     {return std::get<int64_t>(val);}
-    inline auto value::as_int64()           -> int64_t&                    {return std::get<int64_t>(val);}
-    inline auto value::as_uint64()    const -> uint64_t                    {return std::get<uint64_t>(val);}
-    inline auto value::as_uint64()          -> uint64_t&                   {return std::get<uint64_t>(val);}
-    inline auto value::as_real()      const -> double                      {return std::get<double>(val);}
-    inline auto value::as_real()            -> double&                     {return std::get<double>(val);}
-    inline auto value::as_str()       const -> const std::string&          {return std::get<std::string>(val);}
-    inline auto value::as_str()             -> std::string&                {return std::get<std::string>(val);}
-    inline auto value::as_bin()       const -> const std::vector<char>&    {return std::get<std::vector<char>>(val);}
-    inline auto value::as_bin()             -> std::vector<char>&          {return std::get<std::vector<char>>(val);}
-    inline auto value::as_array()     const -> const std::vector<value>&   {return std::get<std::vector<value>>(val);}
-    inline auto value::as_array()           -> std::vector<value>&         {return std::get<std::vector<value>>(val);}
-    inline auto value::as_object()    const -> const std::map<std::string, value>& {return std::get<std::map<std::string, value>>(val);}
-    inline auto value::as_object()          -> std::map<std::string, value>&       {return std::get<std::map<std::string, value>>(val);}
-
-    inline const value& value::at(const std::string& key) const { return std::get<std::map<std::string, value>>(val).at(key); }
-    inline value&       value::at(const std::string& key)       { return std::get<std::map<std::string, value>>(val).at(key); }  
-
-    inline value& value::operator[](const std::string& key)
-    {
-        if (!std::holds_alternative<std::map<std::string, value>>(val))
-            val.emplace<std::map<std::string, value>>();
-        return std::get<std::map<std::string, value>>(val)[key];
-    }
-
-    inline const value& value::operator[](size_t array_index) const { return std::get<std::vector<value>>(val)[array_index]; }
-    inline value&       value::operator[](size_t array_index)       { return std::get<std::vector<value>>(val)[array_index]; }
+        return on_heap() ? heap()->data() : buf;
+    }
 
-//----------------------------------------------------------------------------------------------------------------
+    inline std::size_t value_key::size() const noexcept
+    {
+        return on_heap() ? heap()->size : static_cast<uint8_t>(buf[15]);
+    }
 
-    enum msgpack_identifier : uint8_t
+    inline std::size_t value_key::use_count() const noexcept
     {
-        MSGPACK_NIL         = 0xc0,
+        return on_heap() ? heap()->refs.load(std::memory_order_relaxed) : 0;
+    }
+
+    inline bool operator==(const value_key& a, const value_key& b) noexcept
+    {
+        if (std::memcmp(a.buf, b.buf, sizeof(a.buf)) == 0)
+            return true;
+        if (!a.on_heap() || !b.on_heap())
+            return false;
+        return a.view() == b.view();
+    }
+
+    inline bool operator<(const value_key& a, const value_key& b) noexcept
+    {
+        if (a.on_heap() && b.on_heap() && a.heap() == b.heap())
+            return false;
+        return a.view() < b.view();
+    }
+
+    inline value_key key_interner::intern(std::string_view s)
+    {
+        if (s.size() <= value_key::inline_capacity)
+            return value_key(s);
+
+        if (const auto it = keys.find(s) ; it != end(keys))
+            return it->second;
+
+        value_key k(s);
+        if (keys.size() < max_keys)
+            keys.emplace(k.view(), k);
+        return k;
+    }
+
+    inline key_interner& key_interner::local()
+    {
+        static thread_local key_interner interner;
+        return interner;
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    inline value::value(std::nullptr_t)        {}
+    inline value::value(bool v)                {n.b = {BOOL, v};}
+    inline value::value(const char* v)         {set_str(v);}
+    inline value::value(std::string_view v)    {set_str(v);}
+    inline value::value(std::vector<char> v)   {n.bin = {BIN, new std::vector<char>(std::move(v))};}
+    inline value::value(std::vector<value> v)  {n.arr = {ARRAY, new array_block(std::move(v))};}
+    inline value::value(std::vector<int64_t> v) {n.i64s = {I64_ARRAY, new i64_block(std::move(v))};}
+    inline value::value(std::vector<double> v)  {n.f64s = {F64_ARRAY, new f64_block(std::move(v))};}
+    inline value::value(value_map v)           {n.obj = {OBJECT, new object_block(std::move(v))};}
+    inline value::value(const std::map<std::string, value>& v) {n.obj = {OBJECT, new object_block(begin(v), end(v))};}
+
+    inline value::value(std::string v)
+    {
+        if (v.size() <= small_capacity)
+            set_str(v);
+        else
+            n.str = {STR, new std::string(std::move(v))};
+    }
+
+    template<class Int, check_sint<Int>>
+    inline value::value(Int v) {n.i = {INT64, static_cast<int64_t>(v)};}
+
+    template<class UInt, check_uint<UInt>>
+    inline value::value(UInt v) {n.u = {UINT64, static_cast<uint64_t>(v)};}
+
+    template<class Real, check_float<Real>>
+    inline value::value(Real v) {n.d = {REAL, static_cast<double>(v)};}
+
+    inline value::value(std::initializer_list<value> v)
+    {
+        const bool is_object = std::all_of(begin(v), end(v), [](const auto& el) {
+            return el.is_array() && el.size() == 2 && el[0].is_str();
+        });
+
+        if (is_object)
+        {
+            auto map = std::make_unique<object_block>();
+            for (const auto& el : v)
+                map->emplace(el[0].as_str(), el[1]);
+            n.obj = {OBJECT, map.release()};
+        }
+        else
+            n.arr = {ARRAY, new array_block(v)};
+    }
+
+    inline value::value(const value& ori)
+    {
+        copy_from(ori);
+    }
+
+    inline value::value(value&& ori) noexcept
+    :   n{ori.n}
+    {
+        ori.n = node{};
+    }
+
+    inline value& value::operator=(const value& ori)
+    {
+        if (this != &ori)
+        {
+            value tmp(ori);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    inline value& value::operator=(value&& ori) noexcept
+    {
+        if (this != &ori)
+        {
+            // Steal first: ori may be owned by this
+            const node tmp = ori.n;
+            ori.n = node{};
+            reset();
+            n = tmp;
+        }
+        return *this;
+    }
+
+    inline value::~value()
+    {
+        reset();
+    }
+
+    inline void value::reset() noexcept
+    {
+        switch(tag())
+        {
+        case STR:    delete n.str.v; break;
+        case BIN:    delete n.bin.v; break;
+        case ARRAY:  delete n.arr.v; break;
+        case OBJECT: delete n.obj.v; break;
+        case I64_ARRAY: delete n.i64s.v; break;
+        case F64_ARRAY: delete n.f64s.v; break;
+        case LAZY:      delete n.lazy.v; break;
+        default:                     break;
+        }
+        n = node{};
+    }
+
+    inline void value::set_str(std::string_view v)
+    {
+        if (v.size() <= small_capacity)
+        {
+            n.s = {SMALL_STR, static_cast<uint8_t>(v.size()), {}};
+            std::memcpy(n.s.data, v.data(), v.size());
+        }
+        else
+            n.str = {STR, new std::string(v)};
+    }
+
+    inline void value::copy_from(const value& other)
+    {
+        switch(other.tag())
+        {
+        case STR:    set_str(*other.n.str.v);                                break;
+        case BIN:    n.bin = {BIN,    new std::vector<char>(*other.n.bin.v)};  break;
+        case ARRAY:  n.arr = {ARRAY,  new array_block(*other.n.arr.v)};        break;
+        case OBJECT: n.obj = {OBJECT, new object_block(*other.n.obj.v)};       break;
+        case I64_ARRAY: n.i64s = {I64_ARRAY, new i64_block(*other.n.i64s.v)};           break;
+        case F64_ARRAY: n.f64s = {F64_ARRAY, new f64_block(*other.n.f64s.v)};           break;
+        case LAZY:      n.lazy = {LAZY, new lazy_node{other.n.lazy.v->bytes, other.n.lazy.v->opts, other.n.lazy.v->decodes_to, other.n.lazy.v->size}}; break;
+        default:     n = other.n;                                              break;
+        }
+    }
+
+    inline void value::make_generic_array()
+    {
+        if (tag() == I64_ARRAY || tag() == F64_ARRAY)
+        {
+            auto& slot = tag() == I64_ARRAY ? n.i64s.v->generic : n.f64s.v->generic;
+            std::unique_ptr<array_block> v(slot.exchange(nullptr));
+            if (!v)
+                v = generic_copy();
+            reset();
+            n.arr = {ARRAY, v.release()};
+        }
+    }
+
+    // Non-negative integers become uint64, as they would through pack() and unpack()
+    inline auto value::generic_copy() const -> std::unique_ptr<array_block>
+    {
+        auto v = std::make_unique<array_block>();
+        if (tag() == I64_ARRAY)
+        {
+            v->reserve(n.i64s.v->size());
+            for (const int64_t x : *n.i64s.v)
+                v->push_back(x < 0 ? value(x) : value(static_cast<uint64_t>(x)));
+        }
+        else
+            v->assign(begin(*n.f64s.v), end(*n.f64s.v));
+        return v;
+    }
+
+    // Readers racing to build the copy publish the first one and discard theirs
+    inline auto value::generic_view() const -> const array_block&
+    {
+        auto&        slot = tag() == I64_ARRAY ? n.i64s.v->generic : n.f64s.v->generic;
+        array_block* g    = slot.load(std::memory_order_acquire);
+        if (!g)
+        {
+            auto fresh = generic_copy();
+            if (slot.compare_exchange_strong(g, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+                g = fresh.release();
+        }
+        return *g;
+    }
+
+    inline void value::drop_generic_view() noexcept
+    {
+        if (tag() == I64_ARRAY)
+            delete n.i64s.v->generic.exchange(nullptr);
+        else if (tag() == F64_ARRAY)
+            delete n.f64s.v->generic.exchange(nullptr);
+    }
+
+    inline void value::touch() noexcept
+    {
+        if (auto* slot = cache_slot(); slot && *slot)
+            (*slot)->clear();
+    }
+
+    inline std::unique_ptr<std::vector<char>>* value::cache_slot() noexcept
+    {
+        switch(tag())
+        {
+        case ARRAY:  return &n.arr.v->encoded;
+        case OBJECT: return &n.obj.v->encoded;
+        default:     return nullptr;
+        }
+    }
+
+    inline void value::expect(kind k) const
+    {
+        if (tag() != k)
+            throw std::bad_variant_access();
+    }
+
+    inline size_t value::size() const noexcept
+    {
+        switch(tag())
+        {
+        case NIL:    return 0;
+        case BIN:    return n.bin.v->size();
+        case ARRAY:  return n.arr.v->size();
+        case OBJECT: return n.obj.v->size();
+        case I64_ARRAY: return n.i64s.v->size();
+        case F64_ARRAY: return n.f64s.v->size();
+        case LAZY:      return n.lazy.v->size;
+        default:     return 1;
+        }
+    }
+
+    inline bool value::is_null()   const noexcept {return tag() == NIL;}
+    inline bool value::is_bool()   const noexcept {return tag() == BOOL;}
+    inline bool value::is_int()    const noexcept {return tag() == INT64 || tag() == UINT64;}
+    inline bool value::is_real()   const noexcept {return tag() == REAL;}
+    inline bool value::is_str()    const noexcept {return tag() == SMALL_STR || tag() == STR;}
+    inline bool value::is_binary() const noexcept {return tag() == BIN;}
+    inline bool value::is_array()  const noexcept {const kind k = decoded_tag(); return k == ARRAY || k == I64_ARRAY || k == F64_ARRAY;}
+    inline bool value::is_object() const noexcept {return decoded_tag() == OBJECT;}
+    inline bool value::is_i64_array() const noexcept {return decoded_tag() == I64_ARRAY;}
+    inline bool value::is_f64_array() const noexcept {return decoded_tag() == F64_ARRAY;}
+
+    inline auto value::as_bool()      const -> bool                        {expect(BOOL);   return n.b.v;}
+    inline auto value::as_bool()            -> bool&                       {expect(BOOL);   return n.b.v;}
+    inline auto value::as_int64()     const -> int64_t                     {expect(INT64);  return n.i.v;}
+    inline auto value::as_int64()           -> int64_t&                    {expect(INT64);  return n.i.v;}
+    inline auto value::as_uint64()    const -> uint64_t                    {expect(UINT64); return n.u.v;}
+    inline auto value::as_uint64()          -> uint64_t&                   {expect(UINT64); return n.u.v;}
+    inline auto value::as_real()      const -> double                      {expect(REAL);   return n.d.v;}
+    inline auto value::as_real()            -> double&                     {expect(REAL);   return n.d.v;}
+    inline auto value::as_bin()       const -> const std::vector<char>&    {expect(BIN);    return *n.bin.v;}
+    inline auto value::as_bin()             -> std::vector<char>&          {expect(BIN);    return *n.bin.v;}
+    inline auto value::as_array()     const -> const std::vector<value>&
+    {
+        const value& v = resolved();
+        if (v.tag() == I64_ARRAY || v.tag() == F64_ARRAY)
+            return v.generic_view();
+        v.expect(ARRAY);
+        return *v.n.arr.v;
+    }
+
+    inline auto value::as_array()           -> std::vector<value>&         {materialize(); make_generic_array(); expect(ARRAY); touch(); return *n.arr.v;}
+    inline auto value::as_i64_array() const -> const std::vector<int64_t>& {const value& v = resolved(); v.expect(I64_ARRAY); return *v.n.i64s.v;}
+    inline auto value::as_i64_array()       -> std::vector<int64_t>&       {materialize(); expect(I64_ARRAY); drop_generic_view(); return *n.i64s.v;}
+    inline auto value::as_f64_array() const -> const std::vector<double>&  {const value& v = resolved(); v.expect(F64_ARRAY); return *v.n.f64s.v;}
+    inline auto value::as_f64_array()       -> std::vector<double>&        {materialize(); expect(F64_ARRAY); drop_generic_view(); return *n.f64s.v;}
+    inline auto value::as_object()    const -> const value_map&            {const value& v = resolved(); v.expect(OBJECT);    return *v.n.obj.v;}
+    inline auto value::as_object()          -> value_map&                  {materialize(); expect(OBJECT); touch(); return *n.obj.v;}
+
+    inline auto value::as_str() const -> std::string_view
+    {
+        if (tag() == SMALL_STR)
+            return {n.s.data, n.s.size};
+        expect(STR);
+        return *n.str.v;
+    }
+
+    inline auto value::as_str() -> std::string&
+    {
+        if (tag() == SMALL_STR)
+            n.str = {STR, new std::string(n.s.data, n.s.size)};
+        expect(STR);
+        return *n.str.v;
+    }
+
+    inline const value& value::at(std::string_view key) const
+    {
+        const auto& map = as_object();
+        const auto  it  = map.find(key);
+        if (it == end(map))
+            throw std::out_of_range("msgpackcpp::value::at");
+        return it->second;
+    }
+
+    inline value& value::at(std::string_view key)
+    {
+        materialize();
+        value& v = const_cast<value&>(std::as_const(*this).at(key));
+        touch();
+        return v;
+    }
+
+    inline value& value::operator[](std::string_view key)
+    {
+        materialize();
+        if (tag() != OBJECT)
+        {
+            auto map = std::make_unique<object_block>();
+            reset();
+            n.obj = {OBJECT, map.release()};
+        }
+        touch();
+        auto& map = *n.obj.v;
+        auto  it  = map.lower_bound(key);
+        if (it == end(map) || key < it->first)
+            it = map.emplace_hint(it, value_key(key), value{});
+        return it->second;
+    }
+
+    inline const value& value::operator[](size_t array_index) const { return as_array()[array_index]; }
+    inline value&       value::operator[](size_t array_index)       { return as_array()[array_index]; }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    enum msgpack_identifier : uint8_t
+    {
+        MSGPACK_NIL         = 0xc0,
         MSGPACK_FALSE       = 0xc2,
         MSGPACK_TRUE        = 0xc3,
         MSGPACK_F32         = 0xca,
@@ -550,12 +1508,223 @@ namespace msgpackcpp
         return format;
     }
 
+    template<class Source>
+    [[noreturn]] inline void throw_bad_format()
+    {
+        if constexpr (is_trusted_source_v<Source>)
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+            __assume(0);
+#else
+            __builtin_unreachable();
+#endif
+        }
+        else
+            throw std::system_error(BAD_FORMAT);
+    }
+
     template<class T>
     void store(char* buf, const T& obj)
     {
         std::memcpy(buf, &obj, sizeof(obj));
     }
 
+    // Number of bytes following a format byte which belong to the fixed-size part of the object:
+    // the value of a scalar or the length field of a string, binary array, array or map.
+    constexpr std::size_t format_extra_bytes(uint8_t f)
+    {
+        switch(f)
+        {
+        case MSGPACK_U8:  case MSGPACK_I8:  case MSGPACK_STR8:  case MSGPACK_BIN8:                                      return 1;
+        case MSGPACK_U16: case MSGPACK_I16: case MSGPACK_STR16: case MSGPACK_BIN16: case MSGPACK_ARR16: case MSGPACK_MAP16: return 2;
+        case MSGPACK_U32: case MSGPACK_I32: case MSGPACK_STR32: case MSGPACK_BIN32: case MSGPACK_ARR32: case MSGPACK_MAP32: 
+        case MSGPACK_F32:                                                                                               return 4;
+        case MSGPACK_U64: case MSGPACK_I64: case MSGPACK_F64:                                                           return 8;
+        default:                                                                                                        return 0;
+        }
+    }
+
+    // Source reading from memory whose size has already been checked
+    template<bool Trusted = false>
+    class unchecked_source
+    {
+    private:
+        const char* ptr{};
+
+    public:
+        static constexpr bool trusted = Trusted;
+
+        explicit unchecked_source(const char* data) : ptr{data} {}
+
+        void operator()(char* bytes, std::size_t nbytes)
+        {
+            std::memcpy(bytes, ptr, nbytes);
+            ptr += nbytes;
+        }
+    };
+
+    // Checked contiguous source over memory, e.g. the bytes of a lazy value
+    class span_source
+    {
+    private:
+        const char* ptr{};
+        std::size_t len{};
+
+    public:
+        span_source(const char* data_, std::size_t size_) : ptr{data_}, len{size_} {}
+
+        void operator()(char* bytes, std::size_t nbytes)
+        {
+            if (len < nbytes)
+                throw std::system_error(OUT_OF_DATA);
+            std::memcpy(bytes, ptr, nbytes);
+            advance(nbytes);
+        }
+
+        const char* data()      const noexcept {return ptr;}
+        std::size_t remaining() const noexcept {return len;}
+        void        advance(std::size_t nbytes) noexcept {ptr += nbytes; len -= nbytes;}
+    };
+
+    // Sink hashing the bytes written to it, 8 at a time. Not a cryptographic hash. Selects canonical_encoding, so
+    // equal data hash equally. The digest doesn't depend on the byte order of the host.
+    class hash_sink
+    {
+    private:
+        uint64_t    h{0x9e3779b97f4a7c15};
+        uint64_t    total{0};
+        char        tail[8]{};
+        std::size_t fill{0};
+
+        static uint64_t load_le(const char* p)
+        {
+            uint64_t w{};
+            std::memcpy(&w, p, 8);
+            return is_little_endian() ? w : byte_swap64(w);
+        }
+
+        static uint64_t mix(uint64_t h, uint64_t w)
+        {
+            h ^= w * 0x87c37b91114253d5;
+            h  = (h << 27 | h >> 37) * 5 + 0x52dce729;
+            return h;
+        }
+
+    public:
+        using encoding_policy = canonical_encoding;
+
+        void operator()(const char* bytes, std::size_t nbytes)
+        {
+            total += nbytes;
+            if (fill > 0)
+            {
+                const std::size_t n = std::min(nbytes, sizeof(tail) - fill);
+                std::memcpy(tail + fill, bytes, n);
+                fill   += n;
+                bytes  += n;
+                nbytes -= n;
+                if (fill < sizeof(tail))
+                    return;
+                h    = mix(h, load_le(tail));
+                fill = 0;
+            }
+            for (; nbytes >= 8 ; bytes += 8, nbytes -= 8)
+                h = mix(h, load_le(bytes));
+            std::memcpy(tail, bytes, nbytes);
+            fill = nbytes;
+        }
+
+        uint64_t digest() const
+        {
+            char last[8]{};
+            std::memcpy(last, tail, fill);
+            uint64_t d = mix(mix(h, load_le(last)), total);
+            d ^= d >> 33;
+            d *= 0xff51afd7ed558ccd;
+            d ^= d >> 33;
+            d *= 0xc4ceb9fe1a85ec53;
+            d ^= d >> 33;
+            return d;
+        }
+    };
+
+    // Reads the format byte and the fixed-size part of the next object, then calls fn(header, format) where
+    // header is a source over the fixed-size part. Contiguous sources get away with a single bounds check.
+    template<SOURCE_TYPE Source, class Fn>
+    inline void read_header(Source& in, Fn&& fn)
+    {
+        if constexpr (is_contiguous_source_v<Source>)
+        {
+            constexpr bool    trusted = is_trusted_source_v<Source>;
+            const char*       ptr     = in.data();
+            if (!trusted && in.remaining() == 0)
+                throw std::system_error(OUT_OF_DATA);
+            const uint8_t     format  = static_cast<uint8_t>(ptr[0]);
+            const std::size_t len     = 1 + format_extra_bytes(format);
+            if (!trusted && in.remaining() < len)
+                throw std::system_error(OUT_OF_DATA);
+            in.advance(len);
+            unchecked_source<trusted> header(ptr + 1);
+            fn(header, format);
+        }
+        else
+        {
+            fn(in, read_format(in));
+        }
+    }
+
+    // Reads the variable-size part of a string or binary array
+    template<SOURCE_TYPE Source, class Container>
+    inline void read_payload(Source& in, Container& v, const uint32_t size)
+    {
+        if constexpr (is_contiguous_source_v<Source>)
+        {
+            if (!is_trusted_source_v<Source> && in.remaining() < size)
+                throw std::system_error(OUT_OF_DATA);
+            const char* ptr = in.data();
+            v.assign(ptr, ptr + size);
+            in.advance(size);
+        }
+        else
+        {
+            v.resize(size);
+            in((char*)v.data(), size);
+        }
+    }
+
+    // Reads the variable-size part of a string or binary array into a buffer of at least size bytes
+    template<SOURCE_TYPE Source>
+    inline void read_bytes(Source& in, char* data, const uint32_t size)
+    {
+        if constexpr (is_contiguous_source_v<Source>)
+        {
+            if (!is_trusted_source_v<Source> && in.remaining() < size)
+                throw std::system_error(OUT_OF_DATA);
+            std::memcpy(data, in.data(), size);
+            in.advance(size);
+        }
+        else
+        {
+            in(data, size);
+        }
+    }
+
+    // Calls encode(buf) -> nbytes with room for at least MaxBytes. Contiguous sinks are encoded into directly.
+    template<std::size_t MaxBytes, SINK_TYPE Sink, class Encode>
+    inline void write_encoded(Sink& out, Encode&& encode)
+    {
+        if constexpr (is_contiguous_sink_v<Sink>)
+        {
+            char* buf = out.reserve(MaxBytes);
+            out.commit(encode(buf));
+        }
+        else
+        {
+            char buf[MaxBytes];
+            out(buf, encode(buf));
+        }
+    }
+
 //----------------------------------------------------------------------------------------------------------------
 
     template<SINK_TYPE Sink>
@@ -569,11 +1738,17 @@ namespace msgpackcpp
     inline void deserialize(Source& in, std::nullptr_t)
     {
         if (read_format(in) != MSGPACK_NIL) 
-            throw std::system_error(BAD_FORMAT);
+            throw_bad_format<Source>();
     }
 
 //----------------------------------------------------------------------------------------------------------------
 
+    inline std::size_t encode(char* buf, bool v)
+    {
+        buf[0] = v ? MSGPACK_TRUE : MSGPACK_FALSE;
+        return 1;
+    }
+
     template<SINK_TYPE Sink>
     inline void serialize(Sink& out, bool v)
     {
@@ -586,206 +1761,248 @@ namespace msgpackcpp
     {
         if      (format == MSGPACK_FALSE) v = false;
         else if (format == MSGPACK_TRUE)  v = true;
-        else throw std::system_error(BAD_FORMAT);
+        else throw_bad_format<Source>();
     }
 
     template<SOURCE_TYPE Source>
     inline void deserialize(Source& in, bool& v)
     {
-        deserialize_(in, read_format(in), v);
+        read_header(in, [&](auto& header, uint8_t format) {deserialize_(header, format, v);});
     }
 
 //----------------------------------------------------------------------------------------------------------------
 
-    template<SINK_TYPE Sink, class UInt, check_uint<UInt>>
-    inline void serialize(Sink& out, UInt v)
+    // Number of significant bits in v (0 for 0)
+    constexpr int bit_width64(uint64_t v)
     {
-        if (v <= MSGPACK_FIXINT_POS)
-        {
-            // positive fixint (7-bit positive integer)
-            const uint8_t v8 = static_cast<uint8_t>(v);
-            out((const char*)&v8, 1);
-        }
-        else if (v <= std::numeric_limits<uint8_t>::max())
-        {
-            // unsigned 8
-            char buf[2];
-            buf[0] = MSGPACK_U8;
-            buf[1] = static_cast<uint8_t>(v);
-            out(buf, sizeof(buf));
-        }
-        else if (v <= std::numeric_limits<uint16_t>::max())
-        {
-            // unsigned 16
-            char buf[3];
-            buf[0] = MSGPACK_U16;
-            store(&buf[1], host_to_b16(static_cast<uint16_t>(v)));
-            out(buf, sizeof(buf));
-        }    
-        else if (v <= std::numeric_limits<uint32_t>::max())
+#if __cpp_lib_bitops
+        return std::bit_width(v);
+#elif defined(__GNUC__) || defined(__clang__)
+        return v == 0 ? 0 : 64 - __builtin_clzll(v);
+#else
+        int n{0};
+        for (; v != 0 ; v >>= 1)
+            ++n;
+        return n;
+#endif
+    }
+
+    struct int_encoding
+    {
+        uint8_t format;     // format byte, 0 for fixints
+        uint8_t fixmask;    // 0xff for fixints, whose format byte is the value itself
+        uint8_t size;       // number of payload bytes
+        uint8_t shift;      // left shift moving the payload to the top bytes of a 64-bit word
+    };
+
+    // Indexed by bit width: [0, 64] for non-negative values, 65 + [0, 64] for negative values v using the width of ~v
+    constexpr std::array<int_encoding, 130> make_int_encodings()
+    {
+        std::array<int_encoding, 130> t{};
+        for (int bits = 0 ; bits <= 64 ; ++bits)
         {
-            // unsigned 32
-            char buf[5];
-            buf[0] = MSGPACK_U32;
-            store(&buf[1], host_to_b32(static_cast<uint32_t>(v)));
-            out(buf, sizeof(buf));
+            t[bits]      = bits <= 7  ? int_encoding{0,           0xff, 0, 0}  :
+                           bits <= 8  ? int_encoding{MSGPACK_U8,  0,    1, 56} :
+                           bits <= 16 ? int_encoding{MSGPACK_U16, 0,    2, 48} :
+                           bits <= 32 ? int_encoding{MSGPACK_U32, 0,    4, 32} :
+                                        int_encoding{MSGPACK_U64, 0,    8, 0};
+            t[65 + bits] = bits <= 5  ? int_encoding{0,           0xff, 0, 0}  :
+                           bits <= 7  ? int_encoding{MSGPACK_I8,  0,    1, 56} :
+                           bits <= 15 ? int_encoding{MSGPACK_I16, 0,    2, 48} :
+                           bits <= 31 ? int_encoding{MSGPACK_I32, 0,    4, 32} :
+                                        int_encoding{MSGPACK_I64, 0,    8, 0};
         }
+        return t;
+    }
+
+    inline constexpr std::array<int_encoding, 130> int_encodings = make_int_encodings();
+
+    // Encodes the two's complement bits of an integer without branching on its magnitude.
+    // Always writes 9 bytes, returns the number of bytes used.
+    inline std::size_t encode_int(char* buf, const uint64_t bits, const bool negative)
+    {
+        const uint64_t      mag = negative ? ~bits : bits;
+        const int_encoding& e   = int_encodings[negative * 65 + bit_width64(mag)];
+        buf[0] = static_cast<char>(e.format | (e.fixmask & bits));
+        store(&buf[1], host_to_b64(bits << e.shift));
+        return 1 + e.size;
+    }
+
+    template<class UInt, check_uint<UInt> = true>
+    inline std::size_t encode(char* buf, UInt v)
+    {
+        return encode_int(buf, static_cast<uint64_t>(v), false);
+    }
+
+    template<class Int, check_sint<Int> = true>
+    inline std::size_t encode(char* buf, Int v)
+    {
+        return encode_int(buf, static_cast<uint64_t>(static_cast<int64_t>(v)), v < 0);
+    }
+
+    // Format of T when encoded with its own width (fixed_encoding, floats)
+    template<class T>
+    constexpr uint8_t fixed_format()
+    {
+        if constexpr (std::is_same_v<T, float>)     return MSGPACK_F32;
+        else if constexpr (std::is_same_v<T, double>)    return MSGPACK_F64;
+        else if constexpr (std::is_signed_v<T>)
+            return sizeof(T) == 1 ? MSGPACK_I8 : sizeof(T) == 2 ? MSGPACK_I16 : sizeof(T) == 4 ? MSGPACK_I32 : MSGPACK_I64;
         else
-        {
-            // unsigned 64
-            char buf[9];
-            buf[0] = MSGPACK_U64;
-            store(&buf[1], host_to_b64(static_cast<uint64_t>(v)));
-            out(buf, sizeof(buf));
-        }
+            return sizeof(T) == 1 ? MSGPACK_U8 : sizeof(T) == 2 ? MSGPACK_U16 : sizeof(T) == 4 ? MSGPACK_U32 : MSGPACK_U64;
+    }
+
+    template<class T>
+    inline void store_be(char* buf, T v)
+    {
+        if constexpr (sizeof(T) == 1)       store(buf, v);
+        else if constexpr (sizeof(T) == 2)  store(buf, host_to_b16(bit_cast<uint16_t>(v)));
+        else if constexpr (sizeof(T) == 4)  store(buf, host_to_b32(bit_cast<uint32_t>(v)));
+        else                                store(buf, host_to_b64(bit_cast<uint64_t>(v)));
+    }
+
+    template<class T>
+    inline T load_be(const char* buf)
+    {
+        if constexpr (sizeof(T) == 1)       {T v; std::memcpy(&v, buf, 1); return v;}
+        else if constexpr (sizeof(T) == 2)  {uint16_t v; std::memcpy(&v, buf, 2); return bit_cast<T>(host_to_b16(v));}
+        else if constexpr (sizeof(T) == 4)  {uint32_t v; std::memcpy(&v, buf, 4); return bit_cast<T>(host_to_b32(v));}
+        else                                {uint64_t v; std::memcpy(&v, buf, 8); return bit_cast<T>(host_to_b64(v));}
+    }
+
+    template<class Int, std::enable_if_t<std::is_integral_v<Int>, bool> = true>
+    inline std::size_t encode_fixed(char* buf, Int v)
+    {
+        buf[0] = fixed_format<Int>();
+        store_be(&buf[1], v);
+        return 1 + sizeof(Int);
+    }
+
+    template<SINK_TYPE Sink, class UInt, check_uint<UInt>>
+    inline void serialize(Sink& out, UInt v)
+    {
+        write_encoded<9>(out, [&](char* buf) {return uses_fixed_encoding<Sink> ? encode_fixed(buf, v) : encode(buf, v);});
     }
 
     template<SINK_TYPE Sink, class Int, check_sint<Int>>
     inline void serialize(Sink& out, Int v)
     {
-        if (v >= 0)
-        {
-            // Positive - convert to corresponding unsigned int
-            const std::make_unsigned_t<Int> p = v;
-            serialize(out, p);
-        }
-        else if (v >= -(1<<5))
-        {
-            // negative fixing (5-bit negative integer)
-            const int8_t v8 = static_cast<int8_t>(v);
-            out((const char*)&v8, 1);
-        }
-        else if (v >= std::numeric_limits<int8_t>::min())
-        {
-            // negative - int8
-            char buf[2];
-            buf[0] = MSGPACK_I8;
-            buf[1] = static_cast<int8_t>(v);
-            out(buf, sizeof(buf));
-        }
-        else if (v >= std::numeric_limits<int16_t>::min())
-        {
-            // negative - int16
-            char buf[3];
-            buf[0] = MSGPACK_I16;
-            store(&buf[1], host_to_b16(static_cast<int16_t>(v)));
-            out(buf, sizeof(buf));
-        }    
-        else if (v >= std::numeric_limits<int32_t>::min())
-        {
-            // negative - int32_t
-            char buf[5];
-            buf[0] = MSGPACK_I32;
-            store(&buf[1], host_to_b32(static_cast<int32_t>(v)));
-            out(buf, sizeof(buf));
-        }
-        else
+        write_encoded<9>(out, [&](char* buf) {return uses_fixed_encoding<Sink> ? encode_fixed(buf, v) : encode(buf, v);});
+    }
+
+    struct int_decoding
+    {
+        uint8_t valid;
+        uint8_t size;       // number of payload bytes
+        uint8_t shift;      // right shift of the big-endian word holding the value in its top bytes
+        uint8_t sext;       // shift pair sign-extending the value, 0 for unsigned formats
+    };
+
+    constexpr std::array<int_decoding, 256> make_int_decodings()
+    {
+        std::array<int_decoding, 256> t{};
+        for (int f = 0 ; f < 256 ; ++f)
         {
-            // negative - int64_t
-            char buf[9];
-            buf[0] = MSGPACK_I64;
-            store(&buf[1], host_to_b64(static_cast<int64_t>(v)));
-            out(buf, sizeof(buf));
+            const uint8_t format = static_cast<uint8_t>(f);
+            if (format_is_fixint_pos(format) || format_is_fixint_neg(format))
+                t[f] = {1, 0, 56, 56};
         }
+        t[MSGPACK_U8]  = {1, 1, 56, 0};
+        t[MSGPACK_U16] = {1, 2, 48, 0};
+        t[MSGPACK_U32] = {1, 4, 32, 0};
+        t[MSGPACK_U64] = {1, 8, 0,  0};
+        t[MSGPACK_I8]  = {1, 1, 56, 56};
+        t[MSGPACK_I16] = {1, 2, 48, 48};
+        t[MSGPACK_I32] = {1, 4, 32, 32};
+        t[MSGPACK_I64] = {1, 8, 0,  0};
+        return t;
+    }
+
+    inline constexpr std::array<int_decoding, 256> int_decodings = make_int_decodings();
+
+    // word holds the format byte (fixints) or the payload in its top bytes
+    inline uint64_t decode_int(const uint64_t word, const int_decoding& d)
+    {
+        const uint64_t x = word >> d.shift;
+        return static_cast<uint64_t>(static_cast<int64_t>(x << d.sext) >> d.sext);
     }
 
     template<SOURCE_TYPE Source, class Int, std::enable_if_t<std::is_integral_v<Int>, bool> = true>
     inline void deserialize_(Source& in, uint8_t format, Int& v)
     {
-        if (format_is_fixint_pos(format))
-        {
-            // positive fixint (7-bit positive integer)
-            v = format;
-        }
-        else if (format_is_fixint_neg(format))
-        {
-            // negative fixing (5-bit negative integer)
-            v = bit_cast<int8_t>(format);
-        }
-        else if (format == MSGPACK_U8)
-        {
-            // unsigned 8
-            uint8_t tmp{};
-            in((char*)&tmp, 1);
-            v = tmp;
-        }
-        else if (format == MSGPACK_U16)
-        {
-            // unsigned 16
-            uint16_t tmp{};
-            in((char*)&tmp, 2);
-            v = host_to_b16(tmp);
-        }
-        else if (format == MSGPACK_U32)
-        {
-            // unsigned 32
-            uint32_t tmp{};
-            in((char*)&tmp, 4);
-            v = host_to_b32(tmp);
-        }
-        else if (format == MSGPACK_U64)
-        {
-            // unsigned 64
-            uint64_t tmp{};
-            in((char*)&tmp, 8);
-            v = host_to_b64(tmp);
-        }
-        else if (format == MSGPACK_I8)
-        {
-            // signed 8
-            int8_t tmp{};
-            in((char*)&tmp, 1);
-            v = tmp;
-        }
-        else if (format == MSGPACK_I16)
-        {
-            // signed 16
-            uint16_t tmp{};
-            in((char*)&tmp, 2);
-            v = bit_cast<int16_t>(host_to_b16(tmp));
-        }
-        else if (format == MSGPACK_I32)
-        {
-            // signed 32
-            uint32_t tmp{};
-            in((char*)&tmp, 4);
-            v = bit_cast<int32_t>(host_to_b32(tmp));
-        }
-        else if (format == MSGPACK_I64)
+        const int_decoding& d = int_decodings[format];
+        if (!d.valid)
+            throw_bad_format<Source>();
+
+        uint64_t word = static_cast<uint64_t>(format) << 56;
+        if (d.size > 0)
         {
-            // signed 64
-            uint64_t tmp{};
-            in((char*)&tmp, 8);
-            v = bit_cast<int64_t>(host_to_b64(tmp));
+            char tmp[8]{};
+            in(tmp, d.size);
+            std::memcpy(&word, tmp, 8);
+            word = host_to_b64(word);
         }
-        else
-            throw std::system_error(BAD_FORMAT);
+        v = static_cast<Int>(decode_int(word, d));
     }
 
     template<SOURCE_TYPE Source, class Int, std::enable_if_t<std::is_integral_v<Int>, bool>>
     inline void deserialize(Source& in, Int& v)
     {
-        deserialize_(in, read_format(in), v);
+        if constexpr (is_contiguous_source_v<Source>)
+        {
+            // Wide path: two unaligned 8-byte loads cover the format byte and any payload
+            if (in.remaining() >= 9)
+            {
+                const char*         ptr = in.data();
+                const int_decoding& d   = int_decodings[static_cast<uint8_t>(ptr[0])];
+                if (!d.valid)
+                    throw_bad_format<Source>();
+                uint64_t w0{}, w1{};
+                std::memcpy(&w0, ptr,     8);
+                std::memcpy(&w1, ptr + 1, 8);
+                const uint64_t word = d.size > 0 ? host_to_b64(w1) : host_to_b64(w0);
+                v = static_cast<Int>(decode_int(word, d));
+                in.advance(1 + d.size);
+                return;
+            }
+        }
+
+        read_header(in, [&](auto& header, uint8_t format) {deserialize_(header, format, v);});
     }
 
 //----------------------------------------------------------------------------------------------------------------
 
-    template<SINK_TYPE Sink>
-    inline void serialize(Sink& out, float v)
+    inline std::size_t encode(char* buf, float v)
     {
-        char buf[5];
         buf[0] = MSGPACK_F32;
         store(&buf[1], host_to_b32(bit_cast<uint32_t>(v)));
-        out(buf, sizeof(buf));
+        return 5;
     }
 
-    template<SINK_TYPE Sink>
-    inline void serialize(Sink& out, double v)
+    inline std::size_t encode(char* buf, double v)
     {
-        char buf[9];
         buf[0] = MSGPACK_F64;
         store(&buf[1], host_to_b64(bit_cast<uint64_t>(v)));
-        out(buf, sizeof(buf));
+        return 9;
+    }
+
+    // NaNs have many bit patterns: canonical_encoding writes them all as the default quiet NaN
+    template<class Float>
+    inline Float canonical_float(Float v)
+    {
+        return v != v ? std::numeric_limits<Float>::quiet_NaN() : v;
+    }
+
+    template<SINK_TYPE Sink>
+    inline void serialize(Sink& out, float v)
+    {
+        write_encoded<5>(out, [&](char* buf) {return encode(buf, uses_canonical_encoding<Sink> ? canonical_float(v) : v);});
+    }
+
+    template<SINK_TYPE Sink>
+    inline void serialize(Sink& out, double v)
+    {
+        write_encoded<9>(out, [&](char* buf) {return encode(buf, uses_canonical_encoding<Sink> ? canonical_float(v) : v);});
     }
 
     template<SOURCE_TYPE Source, class Float, check_float<Float> = true>
@@ -804,48 +2021,58 @@ namespace msgpackcpp
             v = bit_cast<double>(host_to_b64(tmp));
         }
         else
-            throw std::system_error(BAD_FORMAT);
+            throw_bad_format<Source>();
     }
 
     template<SOURCE_TYPE Source, class Float, check_float<Float>>
     inline void deserialize(Source& in, Float& v)
     {
-        deserialize_(in, read_format(in), v);
+        read_header(in, [&](auto& header, uint8_t format) {deserialize_(header, format, v);});
     }
 
 //----------------------------------------------------------------------------------------------------------------
 
-    template<SINK_TYPE Sink>
-    inline void serialize_str_size(Sink& out, const uint32_t size)
+    // 32-bit length header used by fixed_encoding
+    inline std::size_t encode_size32(char* buf, const uint8_t format, const uint32_t size)
+    {
+        buf[0] = format;
+        store(&buf[1], host_to_b32(size));
+        return 5;
+    }
+
+    inline std::size_t encode_str_size(char* buf, const uint32_t size)
     {
         if (size < 32)
         {
-            const uint8_t format = MSGPACK_FIXSTR | static_cast<uint8_t>(size);
-            out((const char*)&format, 1);
+            buf[0] = MSGPACK_FIXSTR | static_cast<uint8_t>(size);
+            return 1;
         }
         else if (size < 256)
         {
-            char buf[2];
             buf[0] = MSGPACK_STR8;
             buf[1] = static_cast<uint8_t>(size);
-            out(buf, sizeof(buf));
+            return 2;
         }
         else if (size < 65536)
         {
-            char buf[3];
             buf[0] = MSGPACK_STR16;
             store(&buf[1], host_to_b16(static_cast<uint16_t>(size)));
-            out(buf, sizeof(buf));
+            return 3;
         }
         else 
         {
-            char buf[5];
             buf[0] = MSGPACK_STR32;
             store(&buf[1], host_to_b32(static_cast<uint32_t>(size)));
-            out(buf, sizeof(buf));
+            return 5;
         }
     }
 
+    template<SINK_TYPE Sink>
+    inline void serialize_str_size(Sink& out, const uint32_t size)
+    {
+        write_encoded<5>(out, [&](char* buf) {return uses_fixed_encoding<Sink> ? encode_size32(buf, MSGPACK_STR32, size) : encode_str_size(buf, size);});
+    }
+
     template<SOURCE_TYPE Source>
     inline void deserialize_str_size_(Source& in, uint8_t format, uint32_t& size)
     {
@@ -872,13 +2099,13 @@ namespace msgpackcpp
             size = host_to_b32(size32);
         }
         else
-            throw std::system_error(BAD_FORMAT);
+            throw_bad_format<Source>();
     }
 
     template<SOURCE_TYPE Source>
     inline void deserialize_str_size(Source& in, uint32_t& size)
     {
-        deserialize_str_size_(in, read_format(in), size);
+        read_header(in, [&](auto& header, uint8_t format) {deserialize_str_size_(header, format, size);});
     }
 
     template<SINK_TYPE Sink>
@@ -899,44 +2126,47 @@ namespace msgpackcpp
     {
         uint32_t size{};
         deserialize_str_size_(in, format, size);
-        v.resize(size);
-        in(v.data(), size);
+        read_payload(in, v, size);
     }
 
     template<SOURCE_TYPE Source>
     inline void deserialize(Source& in, std::string& v)
     {
-        deserialize_(in, read_format(in), v);
+        uint32_t size{};
+        deserialize_str_size(in, size);
+        read_payload(in, v, size);
     }
 
 //----------------------------------------------------------------------------------------------------------------
 
-    template<SINK_TYPE Sink>
-    inline void serialize_bin_size(Sink& out, const uint32_t len)
+    inline std::size_t encode_bin_size(char* buf, const uint32_t len)
     {
         if (len < 256)
         {
-            char buf[2];
             buf[0] = MSGPACK_BIN8;
             buf[1] = static_cast<uint8_t>(len);
-            out(buf, sizeof(buf));
+            return 2;
         }
         else if (len < 65536)
         {
-            char buf[3];
             buf[0] = MSGPACK_BIN16;
             store(&buf[1], host_to_b16(static_cast<uint16_t>(len)));
-            out(buf, sizeof(buf));
+            return 3;
         }
         else 
         {
-            char buf[5];
             buf[0] = MSGPACK_BIN32;
             store(&buf[1], host_to_b32(static_cast<uint32_t>(len)));
-            out(buf, sizeof(buf));
+            return 5;
         }
     }
 
+    template<SINK_TYPE Sink>
+    inline void serialize_bin_size(Sink& out, const uint32_t len)
+    {
+        write_encoded<5>(out, [&](char* buf) {return uses_fixed_encoding<Sink> ? encode_size32(buf, MSGPACK_BIN32, len) : encode_bin_size(buf, len);});
+    }
+
     template<SOURCE_TYPE Source>
     inline void deserialize_bin_size_(Source& in, uint8_t format, uint32_t& size)
     {
@@ -959,13 +2189,13 @@ namespace msgpackcpp
             size = host_to_b32(size32);
         }
         else
-            throw std::system_error(BAD_FORMAT);
+            throw_bad_format<Source>();
     }
 
     template<SOURCE_TYPE Source>
     inline void deserialize_bin_size(Source& in, uint32_t& size)
     {
-        deserialize_bin_size_(in, read_format(in), size);
+        read_header(in, [&](auto& header, uint8_t format) {deserialize_bin_size_(header, format, size);});
     }
 
     template<SINK_TYPE Sink>
@@ -992,14 +2222,15 @@ namespace msgpackcpp
     {
         uint32_t size{};
         deserialize_bin_size_(in, format, size);
-        v.resize(size);
-        in((char*)v.data(), size);
+        read_payload(in, v, size);
     }
 
     template<SOURCE_TYPE Source, class Byte, class Alloc, check_binary<Byte>>
     inline void deserialize(Source& in, std::vector<Byte, Alloc>& v)
     {
-        deserialize_(in, read_format(in), v);
+        uint32_t size{};
+        deserialize_bin_size(in, size);
+        read_payload(in, v, size);
     }
 
     template<SOURCE_TYPE Source, class Byte, std::size_t N, check_binary<Byte>>
@@ -1014,30 +2245,33 @@ namespace msgpackcpp
 
 //----------------------------------------------------------------------------------------------------------------
 
-    template<SINK_TYPE Sink>
-    inline void serialize_array_size(Sink& out, const uint32_t size)
+    inline std::size_t encode_array_size(char* buf, const uint32_t size)
     {
         if (size < 16)
         {
-            const uint8_t format = MSGPACK_FIXARR | static_cast<uint8_t>(size);
-            out((const char*)&format, 1);
+            buf[0] = MSGPACK_FIXARR | static_cast<uint8_t>(size);
+            return 1;
         }
         else if (size < 65536)
         {
-            char buf[3];
             buf[0] = MSGPACK_ARR16;
             store(&buf[1], host_to_b16(static_cast<uint16_t>(size)));
-            out(buf, sizeof(buf));
+            return 3;
         }
         else 
         {
-            char buf[5];
             buf[0] = MSGPACK_ARR32;
             store(&buf[1], host_to_b32(static_cast<uint32_t>(size)));
-            out(buf, sizeof(buf));
+            return 5;
         }
     }
 
+    template<SINK_TYPE Sink>
+    inline void serialize_array_size(Sink& out, const uint32_t size)
+    {
+        write_encoded<5>(out, [&](char* buf) {return uses_fixed_encoding<Sink> ? encode_size32(buf, MSGPACK_ARR32, size) : encode_array_size(buf, size);});
+    }
+
     template<SOURCE_TYPE Source>
     inline void deserialize_array_size_(Source& in, uint8_t format, uint32_t& size)
     {
@@ -1058,28 +2292,112 @@ namespace msgpackcpp
             size = host_to_b32(size32);
         }
         else
-            throw std::system_error(BAD_FORMAT);
+            throw_bad_format<Source>();
     }
 
     template<SOURCE_TYPE Source>
     inline void deserialize_array_size(Source& in, uint32_t& size)
     {
-        deserialize_array_size_(in, read_format(in), size);
+        read_header(in, [&](auto& header, uint8_t format) {deserialize_array_size_(header, format, size);});
+    }
+
+    // The bulk paths, load_be and max_encoded_size only know 4 and 8-byte floats, so long double is excluded
+    template<class T>
+    constexpr bool is_packed_arithmetic = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, long double> &&
+                                          !is_binary_value_type<T>;
+
+    // Arrays of numbers in contiguous sinks are encoded with a single reservation for the whole array
+    template<SINK_TYPE Sink, class T>
+    inline void serialize_arithmetic_array(Sink& out, const T* data, const uint32_t size)
+    {
+        // Integer encoders always write 9 bytes: leave slack after the last element
+        char*       buf = out.reserve(5 + size * max_encoded_size_v<T> + 8);
+        std::size_t len{0};
+        if constexpr (uses_fixed_encoding<Sink>)
+        {
+            len += encode_size32(buf, MSGPACK_ARR32, size);
+            for (uint32_t i = 0 ; i < size ; ++i)
+            {
+                if constexpr (std::is_integral_v<T>)
+                    len += encode_fixed(buf + len, data[i]);
+                else
+                    len += encode(buf + len, data[i]);
+            }
+        }
+        else
+        {
+            len += encode_array_size(buf, size);
+            for (uint32_t i = 0 ; i < size ; ++i)
+            {
+                if constexpr (std::is_floating_point_v<T> && uses_canonical_encoding<Sink>)
+                    len += encode(buf + len, canonical_float(data[i]));
+                else
+                    len += encode(buf + len, data[i]);
+            }
+        }
+        out.commit(len);
+    }
+
+    // True if the next size numbers in a contiguous source all have the fixed format of T,
+    // as written by fixed_encoding (or by default for float and double)
+    template<class T, SOURCE_TYPE Source>
+    inline bool is_fixed_array(Source& in, const uint32_t size)
+    {
+        constexpr std::size_t stride = 1 + sizeof(T);
+        if (in.remaining() / stride < size)
+            return false;
+        const char* ptr = in.data();
+        bool ok{true};
+        for (uint32_t i = 0 ; i < size ; ++i)
+            ok &= static_cast<uint8_t>(ptr[i*stride]) == fixed_format<T>();
+        return ok;
+    }
+
+    // Strided loads of an array checked with is_fixed_array()
+    template<class T, SOURCE_TYPE Source>
+    inline void load_fixed_array(Source& in, T* data, const uint32_t size)
+    {
+        constexpr std::size_t stride = 1 + sizeof(T);
+        const char* ptr = in.data();
+        for (uint32_t i = 0 ; i < size ; ++i)
+            data[i] = load_be<T>(ptr + i*stride + 1);
+        in.advance(size * stride);
     }
 
     template<SINK_TYPE Sink, class T, class Alloc, check_nonbinary<T>>
     inline void serialize(Sink& out, const std::vector<T, Alloc>& v)
     { 
-        serialize_array_size(out, v.size());
-        for (const auto& x : v)
-            serialize(out, x);
+        MSGPACK_TRACE_SCOPE(true, TRACE_ARRAY, nullptr, v.size(), out);
+        if constexpr (is_contiguous_sink_v<Sink> && is_packed_arithmetic<T>)
+        {
+            serialize_arithmetic_array(out, v.data(), v.size());
+        }
+        else
+        {
+            serialize_array_size(out, v.size());
+            for (const auto& x : v)
+                serialize(out, x);
+        }
     }
 
     template<SOURCE_TYPE Source, class T, class Alloc, check_nonbinary<T>>
     inline void deserialize(Source& in, std::vector<T, Alloc>& v)
     {
+        MSGPACK_TRACE_SCOPE(false, TRACE_ARRAY, nullptr, 0, in);
         uint32_t size{};
         deserialize_array_size(in, size);
+        MSGPACK_TRACE_COUNT(size);
+
+        if constexpr (is_contiguous_source_v<Source> && is_packed_arithmetic<T>)
+        {
+            if (is_fixed_array<T>(in, size))
+            {
+                v.resize(size);
+                load_fixed_array(in, v.data(), size);
+                return;
+            }
+        }
+
         v.resize(size);
         for (auto& x : v)
             deserialize(in, x);
@@ -1088,48 +2406,71 @@ namespace msgpackcpp
     template<SINK_TYPE Sink, class T, std::size_t N, check_nonbinary<T>>
     inline void serialize(Sink& out, const std::array<T, N>& v)
     {
-        serialize_array_size(out, v.size());
-        for (const auto& x : v)
-            serialize(out, x);
+        MSGPACK_TRACE_SCOPE(true, TRACE_ARRAY, nullptr, N, out);
+        if constexpr (is_contiguous_sink_v<Sink> && is_packed_arithmetic<T>)
+        {
+            serialize_arithmetic_array(out, v.data(), v.size());
+        }
+        else
+        {
+            serialize_array_size(out, v.size());
+            for (const auto& x : v)
+                serialize(out, x);
+        }
     }
 
     template<SOURCE_TYPE Source, class T, std::size_t N, check_nonbinary<T>>
     inline void deserialize(Source& in, std::array<T, N>& v)
     {
+        MSGPACK_TRACE_SCOPE(false, TRACE_ARRAY, nullptr, 0, in);
         uint32_t size{};
         deserialize_array_size(in, size);
         if (size != N)
             throw std::system_error(BAD_SIZE);
+        MSGPACK_TRACE_COUNT(size);
+
+        if constexpr (is_contiguous_source_v<Source> && is_packed_arithmetic<T>)
+        {
+            if (is_fixed_array<T>(in, size))
+            {
+                load_fixed_array(in, v.data(), size);
+                return;
+            }
+        }
+
         for (auto& x : v)
             deserialize(in, x);
     }
 
 //----------------------------------------------------------------------------------------------------------------
 
-    template<SINK_TYPE Sink>
-    inline void serialize_map_size(Sink& out, const uint32_t size)
+    inline std::size_t encode_map_size(char* buf, const uint32_t size)
     {
         if (size < 16)
         {
-            const uint8_t format = MSGPACK_FIXMAP | static_cast<uint8_t>(size);
-            out((const char*)&format, 1);
+            buf[0] = MSGPACK_FIXMAP | static_cast<uint8_t>(size);
+            return 1;
         }
         else if (size < 65536)
         {
-            char buf[3];
             buf[0] = MSGPACK_MAP16;
             store(&buf[1], host_to_b16(static_cast<uint16_t>(size)));
-            out(buf, sizeof(buf));
+            return 3;
         }
         else 
         {
-            char buf[5];
             buf[0] = MSGPACK_MAP32;
             store(&buf[1], host_to_b32(static_cast<uint32_t>(size)));
-            out(buf, sizeof(buf));
+            return 5;
         }
     }
 
+    template<SINK_TYPE Sink>
+    inline void serialize_map_size(Sink& out, const uint32_t size)
+    {
+        write_encoded<5>(out, [&](char* buf) {return uses_fixed_encoding<Sink> ? encode_size32(buf, MSGPACK_MAP32, size) : encode_map_size(buf, size);});
+    }
+
     template<SOURCE_TYPE Source>
     inline void deserialize_map_size_(Source& in, uint8_t format, uint32_t& size)
     {
@@ -1150,24 +2491,43 @@ namespace msgpackcpp
             size = host_to_b32(size32);
         }
         else
-            throw std::system_error(BAD_FORMAT);
+            throw_bad_format<Source>();
     }
 
     template<SOURCE_TYPE Source>
     inline void deserialize_map_size(Source& in, uint32_t& size)
     {
-        deserialize_map_size_(in, read_format(in), size);
+        read_header(in, [&](auto& header, uint8_t format) {deserialize_map_size_(header, format, size);});
     }
 
     template <SINK_TYPE Sink, class Map, check_map<Map>>
     inline void serialize(Sink& out, const Map& map)
     {
+        MSGPACK_TRACE_SCOPE(true, TRACE_MAP, nullptr, map.size(), out);
         serialize_map_size(out, map.size());
         
-        for (const auto& [k,v] : map)
+        if constexpr (uses_canonical_encoding<Sink> && is_unordered_map_v<Map>)
+        {
+            // In key order, as the equivalent std::map would be
+            std::vector<const typename Map::value_type*> entries;
+            entries.reserve(map.size());
+            for (const auto& kv : map)
+                entries.push_back(&kv);
+            std::sort(begin(entries), end(entries), [](const auto* a, const auto* b) {return std::less<>{}(a->first, b->first);});
+
+            for (const auto* kv : entries)
+            {
+                serialize(out, kv->first);
+                serialize(out, kv->second);
+            }
+        }
+        else
         {
-            serialize(out, k);
-            serialize(out, v);
+            for (const auto& [k,v] : map)
+            {
+                serialize(out, k);
+                serialize(out, v);
+            }
         }
     }
 
@@ -1177,8 +2537,10 @@ namespace msgpackcpp
         using K = typename Map::key_type;
         using V = typename Map::mapped_type;
         
+        MSGPACK_TRACE_SCOPE(false, TRACE_MAP, nullptr, 0, in);
         uint32_t size{};
         deserialize_map_size(in, size);
+        MSGPACK_TRACE_COUNT(size);
         
         for (uint32_t i = 0 ; i < size ; ++i)
         {
@@ -1195,6 +2557,7 @@ namespace msgpackcpp
     template<SINK_TYPE Sink, class... Args>
     inline void serialize(Sink& out, const std::tuple<Args...>& tpl)
     {
+        MSGPACK_TRACE_SCOPE(true, TRACE_TUPLE, nullptr, sizeof...(Args), out);
         serialize_array_size(out, sizeof...(Args));
         std::apply([&](auto&&... args) {
             (serialize(out, std::forward<decltype(args)>(args)),...);
@@ -1204,10 +2567,12 @@ namespace msgpackcpp
     template<SOURCE_TYPE Source, class... Args>
     inline void deserialize(Source& in, std::tuple<Args...>& tpl)
     {
+        MSGPACK_TRACE_SCOPE(false, TRACE_TUPLE, nullptr, 0, in);
         uint32_t size{};
         deserialize_array_size(in, size);
         if (size != sizeof...(Args))
             throw std::system_error(BAD_SIZE);
+        MSGPACK_TRACE_COUNT(size);
 
         std::apply([&](auto&&... args) {
             (deserialize(in, std::forward<decltype(args)>(args)),...);
@@ -1216,103 +2581,664 @@ namespace msgpackcpp
 
 //----------------------------------------------------------------------------------------------------------------
 
+    template<SOURCE_TYPE Source>
+    inline void skip_bytes(Source& in, std::size_t nbytes)
+    {
+        if constexpr (is_contiguous_source_v<Source>)
+        {
+            if (!is_trusted_source_v<Source> && in.remaining() < nbytes)
+                throw std::system_error(OUT_OF_DATA);
+            in.advance(nbytes);
+        }
+        else
+        {
+            char tmp[256];
+            while (nbytes > 0)
+            {
+                const std::size_t n = std::min(nbytes, sizeof(tmp));
+                in(tmp, n);
+                nbytes -= n;
+            }
+        }
+    }
+
+    template<SOURCE_TYPE Source>
+    void skip(Source& in)
+    {
+        // Iterative so that deeply nested input can't overflow the stack
+        uint64_t pending{1};
+
+        while (pending > 0)
+        {
+            --pending;
+            read_header(in, [&](auto& header, const uint8_t format) {
+                uint32_t size{};
+
+                if (format_is_string(format))
+                {
+                    deserialize_str_size_(header, format, size);
+                    skip_bytes(in, size);
+                }
+                else if (format_is_binary(format))
+                {
+                    deserialize_bin_size_(header, format, size);
+                    skip_bytes(in, size);
+                }
+                else if (format_is_array(format))
+                {
+                    deserialize_array_size_(header, format, size);
+                    pending += size;
+                }
+                else if (format_is_map(format))
+                {
+                    deserialize_map_size_(header, format, size);
+                    pending += 2 * uint64_t{size};
+                }
+                else if (format == MSGPACK_NIL || format_is_bool(format) || int_decodings[format].valid ||
+                         format == MSGPACK_F32 || format == MSGPACK_F64)
+                {
+                    char tmp[8];
+                    header(tmp, format_extra_bytes(format));
+                }
+                else
+                    throw_bad_format<Source>();
+            });
+        }
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    template<SINK_TYPE Sink>
+    void value::pack(Sink& out) const
+    {
+        switch(tag())
+        {
+        case NIL:       serialize(out, nullptr);                                    break;
+        case BOOL:      serialize(out, n.b.v);                                      break;
+        case INT64:     serialize(out, n.i.v);                                      break;
+        case UINT64:    serialize(out, n.u.v);                                      break;
+        case REAL:      serialize(out, n.d.v);                                      break;
+        case SMALL_STR: serialize(out, std::string_view(n.s.data, n.s.size));       break;
+        case STR:       serialize(out, std::string_view(*n.str.v));                 break;
+        case BIN:       serialize(out, *n.bin.v);                                   break;
+        case I64_ARRAY: serialize(out, static_cast<const std::vector<int64_t>&>(*n.i64s.v)); break;
+        case F64_ARRAY: serialize(out, static_cast<const std::vector<double>&>(*n.f64s.v));  break;
+        case LAZY:
+            // Forwarded verbatim under the default policy, re-encoded for the fixed and canonical layouts
+            if constexpr (std::is_same_v<sink_encoding_policy_t<Sink>, minimal_encoding>)
+                out(n.lazy.v->bytes.data(), n.lazy.v->bytes.size());
+            else
+                resolved().pack(out);
+            break;
+        case ARRAY:
+        {
+            MSGPACK_TRACE_SCOPE(true, TRACE_ARRAY, "value", n.arr.v->size(), out);
+            serialize_array_size(out, n.arr.v->size());
+            for (const auto& el : *n.arr.v)
+                el.pack(out);
+            break;
+        }
+        case OBJECT:
+        {
+            MSGPACK_TRACE_SCOPE(true, TRACE_MAP, "value", n.obj.v->size(), out);
+            serialize_map_size(out, n.obj.v->size());
+            for (const auto& [k,v] : *n.obj.v)
+            {
+                serialize(out, k.view());
+                v.pack(out);
+            }
+            break;
+        }
+        }
+    }
+
+    inline void value::drop_caches() noexcept
+    {
+        if (auto* slot = cache_slot())
+        {
+            slot->reset();
+            if (tag() == ARRAY)
+                for (auto& el : *n.arr.v)
+                    el.drop_caches();
+            else
+                for (auto& [k,v] : *n.obj.v)
+                    v.drop_caches();
+        }
+    }
+
+    inline cached_value::cached_value(value v) : doc(std::move(v))
+    {
+        // Caches left over from an earlier cached_value may have missed edits since
+        doc.drop_caches();
+    }
+
+    inline value& cached_value::edit(path p)
+    {
+        value* v = &doc;
+        v->touch();
+        for (const path_element& e : p)
+        {
+            v = e.is_index ? &v->as_array().at(e.index) : &(*v)[e.key];
+            v->touch();
+        }
+        return *v;
+    }
+
+    inline value cached_value::release()
+    {
+        value v = std::move(doc);
+        doc = value{};
+        v.drop_caches();
+        return v;
+    }
+
+    // Caches are always encoded with minimal_encoding: other policies pack from scratch
     template<SINK_TYPE Sink>
-    inline void value::pack(Sink& out) const
-    {
-        std::visit(overloaded{
-            [&](std::nullptr_t) {
-                serialize(out, nullptr);
-            },
-            [&](const std::vector<value>& v) {
-                serialize_array_size(out, v.size());
-                for (const auto& el : v)
-                    el.pack(out);
-            },
-            [&](const std::map<std::string, value>& m) {
-                serialize_map_size(out, m.size());
-                for (const auto& [k,v] : m)
+    void cached_value::pack(Sink& out)
+    {
+        auto* slot = doc.cache_slot();
+        if (!slot || !std::is_same_v<sink_encoding_policy_t<Sink>, minimal_encoding>)
+        {
+            doc.pack(out);
+            return;
+        }
+
+        // The top level is always cached, and encoded straight into its cache
+        if (!*slot)
+            *slot = std::make_unique<std::vector<char>>();
+        if ((*slot)->empty())
+            doc.encode_composite(**slot);
+        out((*slot)->data(), (*slot)->size());
+    }
+
+    inline void value::encode_composite(std::vector<char>& buf)
+    {
+        auto out = [&buf](const char* bytes, std::size_t nbytes) {buf.insert(end(buf), bytes, bytes + nbytes);};
+
+        if (tag() == ARRAY)
+        {
+            serialize_array_size(out, n.arr.v->size());
+            for (auto& el : *n.arr.v)
+                el.encode_cached(buf);
+        }
+        else
+        {
+            serialize_map_size(out, n.obj.v->size());
+            for (auto& [k,v] : *n.obj.v)
+            {
+                serialize(out, k.view());
+                v.encode_cached(buf);
+            }
+        }
+    }
+
+    // Appends the encoding to buf, copying clean caches and caching the dirty subtrees which are large enough
+    inline void value::encode_cached(std::vector<char>& buf)
+    {
+        auto* slot = cache_slot();
+        if (!slot)
+        {
+            auto out = [&buf](const char* bytes, std::size_t nbytes) {buf.insert(end(buf), bytes, bytes + nbytes);};
+            pack(out);
+        }
+        else if (*slot && !(*slot)->empty())
+        {
+            buf.insert(end(buf), (*slot)->begin(), (*slot)->end());
+        }
+        else
+        {
+            const std::size_t start = buf.size();
+            encode_composite(buf);
+            if (buf.size() - start >= cache_threshold)
+            {
+                if (!*slot)
+                    *slot = std::make_unique<std::vector<char>>();
+                (*slot)->assign(begin(buf) + start, end(buf));
+            }
+        }
+    }
+
+    // Reads a string map key. Contiguous sources are interned straight from their bytes, others go through scratch.
+    template<SOURCE_TYPE Source>
+    inline value_key read_value_key(Source& in, key_interner* keys, std::string& scratch)
+    {
+        uint32_t size{};
+        deserialize_str_size(in, size);
+
+        if constexpr (is_contiguous_source_v<Source>)
+        {
+            if (!is_trusted_source_v<Source> && in.remaining() < size)
+                throw std::system_error(OUT_OF_DATA);
+            const std::string_view name(in.data(), size);
+            value_key key = keys ? keys->intern(name) : value_key(name);
+            in.advance(size);
+            return key;
+        }
+        else
+        {
+            if (size <= value_key::inline_capacity)
+            {
+                char name[value_key::inline_capacity];
+                in(name, size);
+                return value_key(std::string_view(name, size));
+            }
+            scratch.resize(size);
+            in(scratch.data(), size);
+            return keys ? keys->intern(scratch) : value_key(scratch);
+        }
+    }
+
+    template<SOURCE_TYPE Source>
+    void value::unpack(Source& in)
+    {
+        unpack_(in, unpack_options{}, false);
+    }
+
+    template<SOURCE_TYPE Source>
+    void value::unpack(Source& in, key_interner& keys)
+    {
+        unpack_(in, unpack_options{&keys}, false);
+    }
+
+    template<SOURCE_TYPE Source>
+    void value::unpack(Source& in, const unpack_options& opts)
+    {
+        unpack_(in, opts, false);
+    }
+
+    template<SOURCE_TYPE Source>
+    void value::unpack_(Source& in, const unpack_options& opts, bool defer)
+    {
+        MSGPACK_TRACE_MARK(in);
+        read_header(in, [&](auto& header, const uint8_t format) {
+            if (format == MSGPACK_NIL)
+            {
+                reset();
+            }
+            else if (format_is_bool(format))
+            {
+                bool v{};
+                deserialize_(header, format, v);
+                reset();
+                n.b = {BOOL, v};
+            }
+            else if (format_is_float(format))
+            {
+                double v{};
+                deserialize_(header, format, v);
+                reset();
+                n.d = {REAL, v};
+            }
+            else if (format_is_uint(format))
+            {
+                uint64_t v{};
+                deserialize_(header, format, v);
+                reset();
+                n.u = {UINT64, v};
+            }
+            else if (format_is_sint(format))
+            {
+                int64_t v{};
+                deserialize_(header, format, v);
+                reset();
+                n.i = {INT64, v};
+            }
+            else if (format_is_string(format))
+            {
+                uint32_t size{};
+                deserialize_str_size_(header, format, size);
+                if (size <= small_capacity)
                 {
-                    serialize(out, k);
-                    v.pack(out);
+                    small_str v{SMALL_STR, static_cast<uint8_t>(size), {}};
+                    read_bytes(in, v.data, size);
+                    reset();
+                    n.s = v;
                 }
-            },
-            [&](const auto& v) {
-                serialize(out, v);
+                else
+                {
+                    auto v = std::make_unique<std::string>();
+                    read_payload(in, *v, size);
+                    reset();
+                    n.str = {STR, v.release()};
+                }
+            }
+            else if (format_is_binary(format))
+            {
+                uint32_t size{};
+                deserialize_bin_size_(header, format, size);
+                auto v = std::make_unique<std::vector<char>>();
+                read_payload(in, *v, size);
+                reset();
+                n.bin = {BIN, v.release()};
+            }
+            else if (format_is_array(format))
+            {
+                uint32_t size{};
+                deserialize_array_size_(header, format, size);
+                if (defer)
+                {
+                    defer_(in, opts, format, size);
+                    return;
+                }
+                MSGPACK_TRACE_SCOPE_AT(false, TRACE_ARRAY, "value", size);
+                unpack_array_(in, opts, size);
+            }
+            else if (format_is_map(format))
+            {
+                uint32_t size{};
+                deserialize_map_size_(header, format, size);
+                if (defer)
+                {
+                    defer_(in, opts, format, size);
+                    return;
+                }
+                MSGPACK_TRACE_SCOPE_AT(false, TRACE_MAP, "value", size);
+                auto        m = std::make_unique<object_block>();
+                std::string scratch;
+                for (size_t i{0} ; i < size ; ++i)
+                {
+                    value_key k = read_value_key(in, opts.keys, scratch);
+                    value     v;
+                    v.unpack_(in, opts, opts.lazy);
+                    m->emplace_hint(end(*m), std::move(k), std::move(v));
+                }
+                reset();
+                n.obj = {OBJECT, m.release()};
             }
-        }, val);
+            else
+                throw_bad_format<Source>();
+        });
     }
 
+    // True if the next object of a contiguous source is an integer which fits in an int64_t
     template<SOURCE_TYPE Source>
-    inline void value::unpack(Source& in)
+    inline bool next_is_int64(Source& in)
     {
-        const uint8_t format = read_format(in);
-        
-        if (format == MSGPACK_NIL)
+        if constexpr (is_contiguous_source_v<Source>)
+        {
+            if (in.remaining() == 0)
+                return false;
+            const char*   ptr = in.data();
+            const uint8_t f   = static_cast<uint8_t>(ptr[0]);
+            return int_decodings[f].valid && (f != MSGPACK_U64 || (in.remaining() > 1 && (static_cast<uint8_t>(ptr[1]) & 0x80) == 0));
+        }
+        else
+            return false;
+    }
+
+    template<SOURCE_TYPE Source>
+    void value::unpack_array_(Source& in, const unpack_options& opts, const uint32_t size)
+    {
+        if (!opts.typed_arrays || size == 0)
         {
-            /*no-op*/
+            auto v = std::make_unique<array_block>(size);
+            for (auto& el : *v)
+                el.unpack_(in, opts, opts.lazy);
+            reset();
+            n.arr = {ARRAY, v.release()};
+            return;
         }
-        else if (format_is_bool(format))
+
+        if constexpr (is_contiguous_source_v<Source>)
         {
-            bool v{};
-            deserialize_(in, format, v);
-            val = v;
+            if (is_fixed_array<double>(in, size))
+            {
+                auto v = std::make_unique<f64_block>(size);
+                load_fixed_array(in, v->data(), size);
+                reset();
+                n.f64s = {F64_ARRAY, v.release()};
+                return;
+            }
         }
-        else if (format_is_float(format))
+
+        // Stays typed while the elements are all integers or all floats, then carries on as a generic array
+        const auto fits_i64 = [](const value& el) {
+            return el.tag() == INT64 || (el.tag() == UINT64 && el.n.u.v <= uint64_t(std::numeric_limits<int64_t>::max()));
+        };
+
+        value    typed;
+        value    el;
+        bool     pending{false};    // el holds a decoded element which isn't stored yet
+        uint32_t i{0};
+
+        if (!next_is_int64(in))
         {
-            double v{};
-            deserialize_(in, format, v);
-            val = v;
+            el.unpack_(in, opts, opts.lazy);
+            pending = true;
         }
-        else if (format_is_uint(format))
+
+        if (!pending || fits_i64(el))
+            typed = value(std::vector<int64_t>());
+        else if (el.tag() == REAL)
+            typed = value(std::vector<double>());
+
+        if (!typed.is_null())
         {
-            uint64_t v{};
-            deserialize_(in, format, v);
-            val = v;
+            if (typed.tag() == I64_ARRAY)
+                typed.n.i64s.v->reserve(size);
+            else
+                typed.n.f64s.v->reserve(size);
+
+            while (i < size)
+            {
+                if (pending)
+                {
+                    if (typed.tag() == I64_ARRAY && fits_i64(el))
+                        typed.n.i64s.v->push_back(el.tag() == INT64 ? el.n.i.v : static_cast<int64_t>(el.n.u.v));
+                    else if (typed.tag() == F64_ARRAY && el.tag() == REAL)
+                        typed.n.f64s.v->push_back(el.n.d.v);
+                    else
+                        break;
+                    pending = false;
+                    ++i;
+                }
+                else if (typed.tag() == I64_ARRAY && next_is_int64(in))
+                {
+                    int64_t x{};
+                    deserialize(in, x);
+                    typed.n.i64s.v->push_back(x);
+                    ++i;
+                }
+                else
+                {
+                    el.unpack_(in, opts, opts.lazy);
+                    pending = true;
+                }
+            }
+
+            if (i == size)
+            {
+                *this = std::move(typed);
+                return;
+            }
+
+            typed.make_generic_array();
         }
-        else if (format_is_sint(format))
+        else
+            typed = value(std::vector<value>());
+
+        auto& v = *typed.n.arr.v;
+        v.reserve(size);
+        v.push_back(std::move(el));
+        for (++i ; i < size ; ++i)
+            v.emplace_back().unpack_(in, opts, opts.lazy);
+        *this = std::move(typed);
+    }
+
+    // Forwards to a source and appends everything read to a buffer
+    template<SOURCE_TYPE Source>
+    class recording_source
+    {
+    private:
+        Source&            in;
+        std::vector<char>& bytes;
+
+    public:
+        recording_source(Source& in_, std::vector<char>& bytes_) : in{in_}, bytes{bytes_} {}
+
+        void operator()(char* data, std::size_t nbytes)
         {
-            int64_t v{};
-            deserialize_(in, format, v);
-            val = v;
+            in(data, nbytes);
+            bytes.insert(end(bytes), data, data + nbytes);
         }
-        else if (format_is_string(format))
+    };
+
+    template<SOURCE_TYPE Source>
+    void value::defer_(Source& in, const unpack_options& opts, const uint8_t format, const uint32_t size)
+    {
+        const bool is_map = format_is_map(format);
+        auto       l      = std::unique_ptr<lazy_node>(new lazy_node{{}, opts, is_map ? OBJECT : ARRAY, size});
+        auto&      bytes  = l->bytes;
+
+        // The header has been consumed already, so it is written back in its original format
+        char              hdr[5]{static_cast<char>(format)};
+        const std::size_t extra = format_extra_bytes(format);
+        if (extra == 2)
+            store(&hdr[1], host_to_b16(static_cast<uint16_t>(size)));
+        else if (extra == 4)
+            store(&hdr[1], host_to_b32(size));
+        bytes.assign(hdr, hdr + 1 + extra);
+
+        // Work out what a typed unpack will make of an array from the format of each element
+        bool ints   = !is_map && opts.typed_arrays && size > 0;
+        bool floats = ints;
+
+        const uint64_t count = is_map ? 2 * uint64_t{size} : size;
+        for (uint64_t i{0} ; i < count ; ++i)
         {
-            std::string v;
-            deserialize_(in, format, v);
-            val = std::move(v);
+            const std::size_t start = bytes.size();
+
+            if constexpr (is_contiguous_source_v<Source>)
+            {
+                const char* ptr = in.data();
+                skip(in);
+                bytes.insert(end(bytes), ptr, in.data());
+            }
+            else
+            {
+                recording_source<Source> rec(in, bytes);
+                skip(rec);
+            }
+
+            if (ints || floats)
+            {
+                const uint8_t f = static_cast<uint8_t>(bytes[start]);
+                ints   = ints && int_decodings[f].valid && (f != MSGPACK_U64 || (static_cast<uint8_t>(bytes[start + 1]) & 0x80) == 0);
+                floats = floats && format_is_float(f);
+            }
         }
-        else if (format_is_binary(format))
+
+        if (ints)
+            l->decodes_to = I64_ARRAY;
+        else if (floats)
+            l->decodes_to = F64_ARRAY;
+
+        reset();
+        n.lazy = {LAZY, l.release()};
+    }
+
+    // Only the top level is decoded, nested arrays and maps stay lazy
+    inline value value::decoded(const lazy_node& l)
+    {
+        span_source in(l.bytes.data(), l.bytes.size());
+        value       v;
+        v.unpack_(in, l.opts, false);
+        return v;
+    }
+
+    inline void value::materialize()
+    {
+        if (tag() == LAZY)
         {
-            std::vector<char> v;
-            deserialize_(in, format, v);
-            val = std::move(v);
+            lazy_node& l = *n.lazy.v;
+            *this = l.decoded ? std::move(*l.decoded) : decoded(l);
         }
-        else if (format_is_array(format))
+    }
+
+    // The node isn't modified, so that concurrent const readers only synchronise on the once_flag
+    inline const value& value::resolved() const
+    {
+        if (tag() != LAZY)
+            return *this;
+        const lazy_node& l = *n.lazy.v;
+        std::call_once(l.once, [&l] {l.decoded = std::make_unique<value>(decoded(l));});
+        return *l.decoded;
+    }
+
+    inline bool operator==(const value& a, const value& b)
+    {
+        using kind = value::kind;
+
+        if (&a == &b)
+            return true;
+
+        if (a.tag() == kind::LAZY || b.tag() == kind::LAZY)
         {
-            uint32_t size{};
-            deserialize_array_size_(in, format, size);
-            std::vector<value> v(size);
-            for (auto& el : v)
-                el.unpack(in);
-            val = std::move(v);
+            if (a.tag() == b.tag() && a.n.lazy.v->bytes == b.n.lazy.v->bytes)
+                return true;
+            return a.resolved() == b.resolved();
         }
-        else if (format_is_map(format))
+
+        const auto real_bits = [](double d) {return bit_cast<uint64_t>(canonical_float(d));};
+
+        if (a.is_array() && b.is_array())
         {
-            uint32_t size{};
-            deserialize_map_size_(in, format, size);
-            std::map<std::string, value> m;
-            for (size_t i{0} ; i < size ; ++i)
+            if (a.size() != b.size())
+                return false;
+            if (a.tag() == kind::I64_ARRAY && b.tag() == kind::I64_ARRAY)
+                return *a.n.i64s.v == *b.n.i64s.v;
+            if (a.tag() == kind::F64_ARRAY && b.tag() == kind::F64_ARRAY)
+                return std::equal(begin(*a.n.f64s.v), end(*a.n.f64s.v), begin(*b.n.f64s.v), [&](double x, double y) {
+                    return real_bits(x) == real_bits(y);
+                });
+            if (a.tag() == kind::ARRAY && b.tag() == kind::ARRAY)
+                return *a.n.arr.v == *b.n.arr.v;
+            if (a.tag() != kind::ARRAY && b.tag() != kind::ARRAY)
+                return a.size() == 0;   // integers against floats
+
+            // A generic array against a typed one, element by element
+            const value& g = a.tag() == kind::ARRAY ? a : b;
+            const value& t = a.tag() == kind::ARRAY ? b : a;
+            for (std::size_t i = 0 ; i < g.size() ; ++i)
             {
-                std::string k;
-                value       v;
-                deserialize(in, k);
-                v.unpack(in);
-                m.emplace(std::make_pair(std::move(k), std::move(v)));
+                const value el = t.tag() == kind::I64_ARRAY ? value((*t.n.i64s.v)[i]) : value((*t.n.f64s.v)[i]);
+                if ((*g.n.arr.v)[i] != el)
+                    return false;
             }
-            val = std::move(m);
+            return true;
         }
-        else
-            throw std::system_error(BAD_FORMAT);
+
+        if (a.is_int() && b.is_int())
+        {
+            if (a.tag() == b.tag())
+                return a.n.u.v == b.n.u.v;
+            const int64_t  x = a.tag() == kind::INT64 ? a.n.i.v : b.n.i.v;
+            const uint64_t y = a.tag() == kind::INT64 ? b.n.u.v : a.n.u.v;
+            return x >= 0 && static_cast<uint64_t>(x) == y;
+        }
+
+        if (a.is_str() && b.is_str())
+            return a.as_str() == b.as_str();
+
+        if (a.tag() != b.tag())
+            return false;
+
+        switch(a.tag())
+        {
+        case kind::NIL:     return true;
+        case kind::BOOL:    return a.n.b.v == b.n.b.v;
+        case kind::REAL:    return real_bits(a.n.d.v) == real_bits(b.n.d.v);
+        case kind::BIN:     return *a.n.bin.v == *b.n.bin.v;
+        case kind::OBJECT:  return *a.n.obj.v == *b.n.obj.v;
+        default:            return false;
+        }
+    }
+
+    inline uint64_t hash(const value& v)
+    {
+        hash_sink h;
+        v.pack(h);
+        return h.digest();
     }
 
     template<SOURCE_TYPE Source>
@@ -1323,6 +3249,31 @@ namespace msgpackcpp
         return jv;
     }
 
+    template<SOURCE_TYPE Source>
+    inline value unpack(Source& in, key_interner& keys)
+    {
+        value jv;
+        jv.unpack(in, keys);
+        return jv;
+    }
+
+    template<SOURCE_TYPE Source>
+    inline value unpack(Source& in, const unpack_options& opts)
+    {
+        value jv;
+        jv.unpack(in, opts);
+        return jv;
+    }
+
 //----------------------------------------------------------------------------------------------------------------
 
 }
+
+namespace std
+{
+    template <>
+    struct hash<msgpackcpp::value>
+    {
+        size_t operator()(const msgpackcpp::value& v) const {return static_cast<size_t>(msgpackcpp::hash(v));}
+    };
+}
@@ -1,10 +1,70 @@
 #pragma once
 
+#include <string>
+#include <type_traits>
 #include <boost/describe/members.hpp>
 #include "msgpack.h"
 
 namespace msgpackcpp
 {
+    template<class T, class D>
+    using describe_member_t = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<T&>().*D::pointer)>>;
+
+    template<class T, class L>
+    struct describe_max_encoded_size;
+
+    template<class T, template<class...> class L, class... D>
+    struct describe_max_encoded_size<T, L<D...>>
+    {
+        static constexpr bool bounded = (has_max_encoded_size_v<describe_member_t<T, D>> && ...);
+
+        template<class M>
+        static constexpr std::size_t member_size()
+        {
+            if constexpr (has_max_encoded_size_v<M>)
+                return max_encoded_size_v<M>;
+            else
+                return 0;
+        }
+
+        static constexpr std::size_t as_array = encoded_array_header_size(sizeof...(D)) + 
+                                                (std::size_t{0} + ... + member_size<describe_member_t<T, D>>());
+
+        static constexpr std::size_t as_map   = encoded_map_header_size(sizeof...(D)) + 
+                                                (std::size_t{0} + ... + (max_encoded_str_size(std::char_traits<char>::length(D::name)) + 
+                                                                         member_size<describe_member_t<T, D>>()));
+    };
+
+    template<class T, class L>
+    struct describe_max_encoded_headers;
+
+    template<class T, template<class...> class L, class... D>
+    struct describe_max_encoded_headers<T, L<D...>>
+    {
+        static constexpr bool bounded = (has_max_encoded_headers_v<describe_member_t<T, D>> && ...);
+
+        template<class M>
+        static constexpr std::size_t member_headers()
+        {
+            if constexpr (has_max_encoded_headers_v<M>)
+                return max_encoded_headers_v<M>;
+            else
+                return 0;
+        }
+
+        // The container, every member, and a key per member as a map
+        static constexpr std::size_t value = 1 + sizeof...(D) + (std::size_t{0} + ... + member_headers<describe_member_t<T, D>>());
+    };
+
+    template<class T>
+    struct max_encoded_headers<T, std::enable_if_t<describe_max_encoded_headers<T, boost::describe::describe_members<T, boost::describe::mod_any_access>>::bounded>>
+    : std::integral_constant<std::size_t, describe_max_encoded_headers<T, boost::describe::describe_members<T, boost::describe::mod_any_access>>::value> {};
+
+    // Described structs are bounded when all their members are. The bound covers both as_map = false and as_map = true.
+    template<class T>
+    struct max_encoded_size<T, std::enable_if_t<describe_max_encoded_size<T, boost::describe::describe_members<T, boost::describe::mod_any_access>>::bounded>>
+    : std::integral_constant<std::size_t, std::max(describe_max_encoded_size<T, boost::describe::describe_members<T, boost::describe::mod_any_access>>::as_array,
+                                                   describe_max_encoded_size<T, boost::describe::describe_members<T, boost::describe::mod_any_access>>::as_map)> {};
     template <
         class Stream, 
         class T,
@@ -12,11 +72,13 @@ namespace msgpackcpp
     >
     inline void serialize(Stream& out, const T& obj, bool as_map = false)
     { 
+        MSGPACK_TRACE_SCOPE(true, TRACE_STRUCT, nullptr, boost::mp11::mp_size<D1>::value, out);
         if (as_map)
         {
             serialize_map_size(out, boost::mp11::mp_size<D1>::value);
 
             boost::mp11::mp_for_each<D1>([&](auto D) {
+                MSGPACK_TRACE_SCOPE(true, TRACE_MEMBER, D.name, 1, out);
                 serialize(out, D.name);
                 serialize(out, obj.*D.pointer);
             });
@@ -26,6 +88,7 @@ namespace msgpackcpp
             serialize_array_size(out, boost::mp11::mp_size<D1>::value);
 
             boost::mp11::mp_for_each<D1>([&](auto D) {
+                MSGPACK_TRACE_SCOPE(true, TRACE_MEMBER, D.name, 1, out);
                 serialize(out, obj.*D.pointer);
             });
         }
@@ -38,6 +101,7 @@ namespace msgpackcpp
     >
     inline void deserialize(Source& in, T& obj, bool as_map = false)
     { 
+        MSGPACK_TRACE_SCOPE(false, TRACE_STRUCT, nullptr, boost::mp11::mp_size<D1>::value, in);
         if (as_map)
         {
             uint32_t size{};
@@ -46,6 +110,7 @@ namespace msgpackcpp
                 throw std::system_error(BAD_SIZE); 
 
             boost::mp11::mp_for_each<D1>([&](auto D) {
+                MSGPACK_TRACE_SCOPE(false, TRACE_MEMBER, D.name, 1, in);
                 std::string name;
                 deserialize(in, name);
                 if (name != D.name)
@@ -61,6 +126,7 @@ namespace msgpackcpp
                 throw std::system_error(BAD_SIZE); 
 
             boost::mp11::mp_for_each<D1>([&](auto D) {
+                MSGPACK_TRACE_SCOPE(false, TRACE_MEMBER, D.name, 1, in);
                 deserialize(in, obj.*D.pointer);
             });
         }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+
+// Explicit instantiations of the library for the common sinks and sources.
+//
+// Every translation unit including this header sees them as `extern template` declarations and skips their bodies.
+// Exactly one translation unit of the program must define MSGPACK_INSTANTIATE_TEMPLATES before including it,
+// which compiles them. Include it right after the other msgpack headers, before any (de)serialization code.
+//
+// Optimizing compilers still instantiate the small scalar encoders and decoders, which are inline, so that they can
+// be inlined. value::pack(), cached_value::pack(), value::unpack() and skip() are always skipped.
+//
+// Instantiate for your own sink and source types with MSGPACK_EXTERN_SINK(Type) and MSGPACK_EXTERN_SOURCE(Type)
+// at namespace msgpackcpp scope.
+
+#ifdef MSGPACK_INSTANTIATE_TEMPLATES
+#define MSGPACK_EXTERN_TEMPLATE template
+#else
+#define MSGPACK_EXTERN_TEMPLATE extern template
+#endif
+
+#define MSGPACK_EXTERN_SINK(...) \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, std::nullptr_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, bool); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, char); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, int8_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, int16_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, int32_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, int64_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, uint8_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, uint16_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, uint32_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, uint64_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, float); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, double); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, std::string_view); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, const char*); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, const std::vector<char>&); \
+    MSGPACK_EXTERN_TEMPLATE void serialize(__VA_ARGS__&, const std::vector<uint8_t>&); \
+    MSGPACK_EXTERN_TEMPLATE void serialize_array_size(__VA_ARGS__&, const uint32_t); \
+    MSGPACK_EXTERN_TEMPLATE void serialize_map_size(__VA_ARGS__&, const uint32_t); \
+    MSGPACK_EXTERN_TEMPLATE void value::pack(__VA_ARGS__&) const; \
+    MSGPACK_EXTERN_TEMPLATE void cached_value::pack(__VA_ARGS__&)
+
+#define MSGPACK_EXTERN_SOURCE(...) \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, std::nullptr_t); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, bool&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, char&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, int8_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, int16_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, int32_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, int64_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, uint8_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, uint16_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, uint32_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, uint64_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, float&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, double&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, std::string&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, std::vector<char>&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize(__VA_ARGS__&, std::vector<uint8_t>&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize_array_size(__VA_ARGS__&, uint32_t&); \
+    MSGPACK_EXTERN_TEMPLATE void deserialize_map_size(__VA_ARGS__&, uint32_t&); \
+    MSGPACK_EXTERN_TEMPLATE void value::unpack(__VA_ARGS__&); \
+    MSGPACK_EXTERN_TEMPLATE void value::unpack(__VA_ARGS__&, key_interner&); \
+    MSGPACK_EXTERN_TEMPLATE void value::unpack(__VA_ARGS__&, const unpack_options&); \
+    MSGPACK_EXTERN_TEMPLATE void skip(__VA_ARGS__&)
+
+namespace msgpackcpp
+{
+    MSGPACK_EXTERN_SINK(vector_writer<char, std::allocator<char>>);
+    MSGPACK_EXTERN_SINK(vector_writer<uint8_t, std::allocator<uint8_t>>);
+    MSGPACK_EXTERN_SINK(segmented_writer);
+    MSGPACK_EXTERN_SINK(any_sink);
+
+    MSGPACK_EXTERN_SOURCE(vector_reader<char, std::allocator<char>>);
+    MSGPACK_EXTERN_SOURCE(vector_reader<uint8_t, std::allocator<uint8_t>>);
+    MSGPACK_EXTERN_SOURCE(memory_source);
+    MSGPACK_EXTERN_SOURCE(any_source);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Forward declarations, so that headers can declare (de)serializers for their types without pulling in msgpack.h:
+//
+//  void serialize(msgpackcpp::any_sink& out, const my_struct& obj);
+//  void deserialize(msgpackcpp::any_source& in, my_struct& obj);
+//
+// and define them in a single translation unit.
+
+namespace msgpackcpp
+{
+    class value;
+    class any_sink;
+    class any_source;
+    class memory_source;
+    class segmented_buffer;
+    class segmented_writer;
+    class buffer_pool;
+
+    template<class Byte, class Alloc>
+    class vector_writer;
+
+    template<class Byte, class Alloc>
+    class vector_reader;
+}
@@ -0,0 +1,709 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <exception>
+#include <charconv>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+
+namespace msgpackcpp
+{
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Transcodes the next msgpack object read from in into JSON text written to out, without building a value.
+    // Binary arrays become arrays of byte values, non-string map keys are quoted and NaN/infinities become null.
+    template<SOURCE_TYPE Source, SINK_TYPE Sink>
+    void to_json(Source& in, Sink& out);
+
+    std::string to_json(const char* data, std::size_t size);
+
+    template<class Byte, class Alloc, check_byte<Byte> = true>
+    std::string to_json(const std::vector<Byte, Alloc>& buf);
+
+    // Transcodes one JSON text into msgpack written to out. The text is scanned twice: once to count the
+    // items of every array and object, once to emit. Throws BAD_FORMAT on invalid JSON.
+    template<SINK_TYPE Sink>
+    void from_json(std::string_view json, Sink& out);
+
+//----------------------------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------------------------
+// DEFINITIONS
+//----------------------------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------------------------
+
+    // Batches small writes into a fixed buffer in front of a sink. What is left is flushed on destruction, unless
+    // the writer is destroyed by an exception, which mustn't be followed by more writes to the sink.
+    template<SINK_TYPE Sink>
+    class json_writer
+    {
+    private:
+        Sink&       out;
+        char        buf[4096];
+        std::size_t len{0};
+        int         exceptions{std::uncaught_exceptions()};
+
+    public:
+        explicit json_writer(Sink& out_) : out{out_} {}
+        ~json_writer() noexcept(false)
+        {
+            if (std::uncaught_exceptions() == exceptions)
+                flush();
+        }
+
+        void flush()
+        {
+            if (len > 0)
+                out(buf, len);
+            len = 0;
+        }
+
+        void put(char c)
+        {
+            if (len == sizeof(buf))
+                flush();
+            buf[len++] = c;
+        }
+
+        void write(const char* data, std::size_t size)
+        {
+            if ((sizeof(buf) - len) < size)
+            {
+                flush();
+                if (size > sizeof(buf))
+                {
+                    out(data, size);
+                    return;
+                }
+            }
+            std::memcpy(buf + len, data, size);
+            len += size;
+        }
+
+        // Escapes a chunk of a string, 8 bytes at a time while no byte needs escaping
+        void write_escaped(const char* data, std::size_t size)
+        {
+            constexpr uint64_t ones = 0x0101010101010101ull;
+            constexpr uint64_t high = 0x8080808080808080ull;
+
+            std::size_t i{0};
+            while (i < size)
+            {
+                std::size_t run = i;
+                for (; run + 8 <= size ; run += 8)
+                {
+                    uint64_t x;
+                    std::memcpy(&x, data + run, 8);
+                    const uint64_t ctrl  = (x - ones * 0x20) & ~x;          // bytes < 0x20
+                    const uint64_t quote = x ^ (ones * '"');
+                    const uint64_t slash = x ^ (ones * '\\');
+                    const uint64_t hits  = (ctrl | ((quote - ones) & ~quote) | ((slash - ones) & ~slash)) & high;
+                    if (hits != 0)
+                        break;
+                }
+                while (run < size)
+                {
+                    const unsigned char c = static_cast<unsigned char>(data[run]);
+                    if (c < 0x20 || c == '"' || c == '\\')
+                        break;
+                    ++run;
+                }
+
+                write(data + i, run - i);
+                if (run == size)
+                    break;
+
+                const unsigned char c = static_cast<unsigned char>(data[run]);
+                switch(c)
+                {
+                case '"':  write("\\\"", 2); break;
+                case '\\': write("\\\\", 2); break;
+                case '\b': write("\\b", 2);  break;
+                case '\f': write("\\f", 2);  break;
+                case '\n': write("\\n", 2);  break;
+                case '\r': write("\\r", 2);  break;
+                case '\t': write("\\t", 2);  break;
+                default:
+                {
+                    constexpr char hex[] = "0123456789abcdef";
+                    const char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                    write(esc, 6);
+                }
+                }
+                i = run + 1;
+            }
+        }
+
+        template<class Int>
+        void write_int(Int v)
+        {
+            char tmp[24];
+            const auto res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+            write(tmp, res.ptr - tmp);
+        }
+
+        template<class Float>
+        void write_real(Float v)
+        {
+            if (!std::isfinite(v))
+            {
+                write("null", 4);
+                return;
+            }
+
+            char tmp[32];
+#if __cpp_lib_to_chars >= 201611L
+            const auto  res = std::to_chars(tmp, tmp + sizeof(tmp), v);
+            std::size_t n   = res.ptr - tmp;
+#else
+            std::size_t n   = std::snprintf(tmp, sizeof(tmp), "%.*g", std::numeric_limits<Float>::max_digits10, static_cast<double>(v));
+#endif
+            // Keep reals distinguishable from integers when read back
+            if (std::string_view(tmp, n).find_first_of(".eEn") == std::string_view::npos)
+            {
+                tmp[n++] = '.';
+                tmp[n++] = '0';
+            }
+            write(tmp, n);
+        }
+    };
+
+    // Copies the payload of a string or binary array, contiguous sources without an intermediate copy
+    template<SOURCE_TYPE Source, class Fn>
+    inline void read_chunks(Source& in, std::size_t size, Fn&& fn)
+    {
+        if constexpr (is_contiguous_source_v<Source>)
+        {
+            if (!is_trusted_source_v<Source> && in.remaining() < size)
+                throw std::system_error(OUT_OF_DATA);
+            fn(in.data(), size);
+            in.advance(size);
+        }
+        else
+        {
+            char tmp[256];
+            while (size > 0)
+            {
+                const std::size_t n = std::min(size, sizeof(tmp));
+                in(tmp, n);
+                fn(tmp, n);
+                size -= n;
+            }
+        }
+    }
+
+    template<SOURCE_TYPE Source, SINK_TYPE Sink>
+    inline void to_json(Source& in, Sink& sink_)
+    {
+        struct frame
+        {
+            uint64_t    remaining;  // items left, keys and values counted separately for maps
+            bool        is_map;
+            bool        first;
+        };
+
+        json_writer<Sink>   out(sink_);
+        std::vector<frame>  stack;
+        bool                done{false};
+
+        while (!done)
+        {
+            bool is_key{false};
+            if (!stack.empty())
+            {
+                frame& f = stack.back();
+                is_key   = f.is_map && (f.remaining % 2) == 0;
+                if (!f.first)
+                    out.put(is_key || !f.is_map ? ',' : ':');
+                f.first = false;
+                --f.remaining;
+            }
+
+            read_header(in, [&](auto& header, const uint8_t format) {
+                uint32_t size{};
+
+                // Non-string keys are written as quoted scalars
+                const bool quote = is_key && !format_is_string(format);
+                if (quote && (format_is_array(format) || format_is_map(format) || format_is_binary(format)))
+                    throw std::system_error(BAD_FORMAT);
+                if (quote)
+                    out.put('"');
+
+                if (format == MSGPACK_NIL)
+                {
+                    out.write("null", 4);
+                }
+                else if (format_is_bool(format))
+                {
+                    if (format == MSGPACK_TRUE) out.write("true", 4);
+                    else                        out.write("false", 5);
+                }
+                else if (int_decodings[format].valid)
+                {
+                    // Decode as signed unless the format is unsigned
+                    if (format >= MSGPACK_U8 && format <= MSGPACK_U64)
+                    {
+                        uint64_t v{};
+                        deserialize_(header, format, v);
+                        out.write_int(v);
+                    }
+                    else
+                    {
+                        int64_t v{};
+                        deserialize_(header, format, v);
+                        out.write_int(v);
+                    }
+                }
+                else if (format == MSGPACK_F32)
+                {
+                    float v{};
+                    deserialize_(header, format, v);
+                    out.write_real(v);
+                }
+                else if (format == MSGPACK_F64)
+                {
+                    double v{};
+                    deserialize_(header, format, v);
+                    out.write_real(v);
+                }
+                else if (format_is_string(format))
+                {
+                    deserialize_str_size_(header, format, size);
+                    out.put('"');
+                    read_chunks(in, size, [&](const char* data, std::size_t n) {out.write_escaped(data, n);});
+                    out.put('"');
+                }
+                else if (format_is_binary(format))
+                {
+                    deserialize_bin_size_(header, format, size);
+                    out.put('[');
+                    bool first{true};
+                    read_chunks(in, size, [&](const char* data, std::size_t n) {
+                        for (std::size_t i = 0 ; i < n ; ++i)
+                        {
+                            if (!first)
+                                out.put(',');
+                            out.write_int(static_cast<unsigned>(static_cast<uint8_t>(data[i])));
+                            first = false;
+                        }
+                    });
+                    out.put(']');
+                }
+                else if (format_is_array(format))
+                {
+                    deserialize_array_size_(header, format, size);
+                    out.put('[');
+                    stack.push_back({size, false, true});
+                }
+                else if (format_is_map(format))
+                {
+                    deserialize_map_size_(header, format, size);
+                    out.put('{');
+                    stack.push_back({2 * uint64_t{size}, true, true});
+                }
+                else
+                    throw_bad_format<Source>();
+
+                if (quote)
+                    out.put('"');
+            });
+
+            while (!stack.empty() && stack.back().remaining == 0)
+            {
+                out.put(stack.back().is_map ? '}' : ']');
+                stack.pop_back();
+            }
+
+            done = stack.empty();
+        }
+    }
+
+    inline std::string to_json(const char* data, std::size_t size)
+    {
+        std::string str;
+        auto out = [&](const char* bytes, std::size_t nbytes) {str.append(bytes, nbytes);};
+        memory_source in(data, size);
+        to_json(in, out);
+        return str;
+    }
+
+    template<class Byte, class Alloc, check_byte<Byte>>
+    inline std::string to_json(const std::vector<Byte, Alloc>& buf)
+    {
+        return to_json(reinterpret_cast<const char*>(buf.data()), buf.size());
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    constexpr bool json_is_space(char c) {return c == ' ' || c == '\n' || c == '\r' || c == '\t';}
+
+    // Pass 1: number of items of every array and object, in order of their opening bracket.
+    // Only strings are parsed; structural errors are left to pass 2.
+    inline std::vector<uint32_t> json_container_sizes(std::string_view json)
+    {
+        struct frame
+        {
+            std::size_t index;
+            bool        empty;
+        };
+
+        std::vector<uint32_t>   sizes;
+        std::vector<frame>      stack;
+
+        for (std::size_t i = 0 ; i < json.size() ; ++i)
+        {
+            const char c = json[i];
+            if (json_is_space(c))
+                continue;
+
+            if (c == ']' || c == '}')
+            {
+                if (stack.empty())
+                    throw std::system_error(BAD_FORMAT);
+                if (!stack.back().empty)
+                    ++sizes[stack.back().index];
+                stack.pop_back();
+                continue;
+            }
+
+            if (!stack.empty())
+            {
+                stack.back().empty = false;
+                if (c == ',')
+                    ++sizes[stack.back().index];
+            }
+
+            if (c == '[' || c == '{')
+            {
+                stack.push_back({sizes.size(), true});
+                sizes.push_back(0);
+            }
+            else if (c == '"')
+            {
+                for (++i ; i < json.size() && json[i] != '"' ; ++i)
+                    if (json[i] == '\\')
+                        ++i;
+            }
+        }
+
+        return sizes;
+    }
+
+    // Pass 2: recursive descent parser emitting msgpack
+    template<SINK_TYPE Sink>
+    class json_parser
+    {
+    private:
+        static constexpr int max_depth = 512;
+
+        std::string_view                json;
+        std::size_t                     pos{0};
+        const std::vector<uint32_t>&    sizes;
+        std::size_t                     next_container{0};
+        Sink&                           out;
+        std::string                     scratch;
+
+        [[noreturn]] static void fail() { throw std::system_error(BAD_FORMAT); }
+
+        void skip_space()
+        {
+            while (pos < json.size() && json_is_space(json[pos]))
+                ++pos;
+        }
+
+        char peek()
+        {
+            skip_space();
+            if (pos == json.size())
+                fail();
+            return json[pos];
+        }
+
+        void expect(std::string_view word)
+        {
+            if (json.substr(pos, word.size()) != word)
+                fail();
+            pos += word.size();
+        }
+
+        static int hex_value(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            fail();
+        }
+
+        uint32_t parse_hex4()
+        {
+            if (json.size() - pos < 4)
+                fail();
+            uint32_t v{0};
+            for (int i = 0 ; i < 4 ; ++i)
+                v = (v << 4) | hex_value(json[pos++]);
+            return v;
+        }
+
+        void append_utf8(uint32_t cp)
+        {
+            if (cp < 0x80)
+                scratch += static_cast<char>(cp);
+            else if (cp < 0x800)
+            {
+                scratch += static_cast<char>(0xc0 | (cp >> 6));
+                scratch += static_cast<char>(0x80 | (cp & 0x3f));
+            }
+            else if (cp < 0x10000)
+            {
+                scratch += static_cast<char>(0xe0 | (cp >> 12));
+                scratch += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                scratch += static_cast<char>(0x80 | (cp & 0x3f));
+            }
+            else
+            {
+                scratch += static_cast<char>(0xf0 | (cp >> 18));
+                scratch += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+                scratch += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                scratch += static_cast<char>(0x80 | (cp & 0x3f));
+            }
+        }
+
+        // Strings without escapes are emitted straight from the input
+        void parse_string()
+        {
+            ++pos;
+            const std::size_t begin = pos;
+            while (pos < json.size() && json[pos] != '"' && json[pos] != '\\')
+            {
+                if (static_cast<unsigned char>(json[pos]) < 0x20)
+                    fail();
+                ++pos;
+            }
+            if (pos == json.size())
+                fail();
+
+            if (json[pos] == '"')
+            {
+                const std::size_t len = pos - begin;
+                serialize_str_size(out, static_cast<uint32_t>(len));
+                out(json.data() + begin, len);
+                ++pos;
+                return;
+            }
+
+            scratch.assign(json.data() + begin, pos - begin);
+            while (true)
+            {
+                if (pos == json.size())
+                    fail();
+
+                const char c = json[pos++];
+                if (c == '"')
+                    break;
+                if (static_cast<unsigned char>(c) < 0x20)
+                    fail();
+                if (c != '\\')
+                {
+                    scratch += c;
+                    continue;
+                }
+
+                if (pos == json.size())
+                    fail();
+                switch(json[pos++])
+                {
+                case '"':  scratch += '"';  break;
+                case '\\': scratch += '\\'; break;
+                case '/':  scratch += '/';  break;
+                case 'b':  scratch += '\b'; break;
+                case 'f':  scratch += '\f'; break;
+                case 'n':  scratch += '\n'; break;
+                case 'r':  scratch += '\r'; break;
+                case 't':  scratch += '\t'; break;
+                case 'u':
+                {
+                    uint32_t cp = parse_hex4();
+                    if (cp >= 0xd800 && cp < 0xdc00)
+                    {
+                        // Surrogate pair
+                        expect("\\u");
+                        const uint32_t lo = parse_hex4();
+                        if (lo < 0xdc00 || lo >= 0xe000)
+                            fail();
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                    }
+                    else if (cp >= 0xdc00 && cp < 0xe000)
+                        fail();
+                    append_utf8(cp);
+                    break;
+                }
+                default: fail();
+                }
+            }
+
+            serialize(out, scratch);
+        }
+
+        void parse_number()
+        {
+            const std::size_t begin = pos;
+            bool              real{false};
+
+            if (json[pos] == '-')
+                ++pos;
+            if (pos == json.size() || json[pos] < '0' || json[pos] > '9')
+                fail();
+            if (json[pos] == '0')
+                ++pos;
+            else
+                while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9')
+                    ++pos;
+            if (pos < json.size() && json[pos] == '.')
+            {
+                real = true;
+                const std::size_t digits = ++pos;
+                while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9')
+                    ++pos;
+                if (pos == digits)
+                    fail();
+            }
+            if (pos < json.size() && (json[pos] == 'e' || json[pos] == 'E'))
+            {
+                real = true;
+                ++pos;
+                if (pos < json.size() && (json[pos] == '+' || json[pos] == '-'))
+                    ++pos;
+                const std::size_t digits = pos;
+                while (pos < json.size() && json[pos] >= '0' && json[pos] <= '9')
+                    ++pos;
+                if (pos == digits)
+                    fail();
+            }
+
+            const char* first = json.data() + begin;
+            const char* last  = json.data() + pos;
+
+            if (!real)
+            {
+                // Integers which don't fit in 64 bits fall through to double
+                if (*first == '-')
+                {
+                    int64_t v{};
+                    const auto res = std::from_chars(first, last, v);
+                    if (res.ec == std::errc{} && res.ptr == last)
+                        return serialize(out, v);
+                }
+                else
+                {
+                    uint64_t v{};
+                    const auto res = std::from_chars(first, last, v);
+                    if (res.ec == std::errc{} && res.ptr == last)
+                        return serialize(out, v);
+                }
+            }
+
+#if __cpp_lib_to_chars >= 201611L
+            double v{};
+            const auto res = std::from_chars(first, last, v);
+            // Out of range: round to infinity or zero like strtod does, rather than keeping 0
+            if (res.ec == std::errc::result_out_of_range)
+                v = std::strtod(std::string(first, last).c_str(), nullptr);
+#else
+            const double v = std::strtod(std::string(first, last).c_str(), nullptr);
+#endif
+            serialize(out, v);
+        }
+
+        void parse_value(int depth)
+        {
+            if (depth > max_depth)
+                fail();
+
+            const char c = peek();
+
+            if (c == '{' || c == '[')
+            {
+                const bool is_map = c == '{';
+                if (next_container == sizes.size())
+                    fail();
+                const uint32_t size = sizes[next_container++];
+                if (is_map)
+                    serialize_map_size(out, size);
+                else
+                    serialize_array_size(out, size);
+
+                ++pos;
+                uint32_t count{0};
+                if (peek() == (is_map ? '}' : ']'))
+                    ++pos;
+                else
+                {
+                    while (true)
+                    {
+                        if (is_map)
+                        {
+                            if (peek() != '"')
+                                fail();
+                            parse_string();
+                            if (peek() != ':')
+                                fail();
+                            ++pos;
+                        }
+                        parse_value(depth + 1);
+                        ++count;
+
+                        const char sep = peek();
+                        ++pos;
+                        if (sep == (is_map ? '}' : ']'))
+                            break;
+                        if (sep != ',')
+                            fail();
+                    }
+                }
+
+                // Pass 1 doesn't validate: a mismatch means the input was malformed
+                if (count != size)
+                    fail();
+            }
+            else if (c == '"')  parse_string();
+            else if (c == 't')  {expect("true");  serialize(out, true);}
+            else if (c == 'f')  {expect("false"); serialize(out, false);}
+            else if (c == 'n')  {expect("null");  serialize(out, nullptr);}
+            else                parse_number();
+        }
+
+    public:
+        json_parser(std::string_view json_, const std::vector<uint32_t>& sizes_, Sink& out_)
+        : json{json_}, sizes{sizes_}, out{out_}
+        {
+        }
+
+        void parse()
+        {
+            parse_value(0);
+            skip_space();
+            if (pos != json.size())
+                fail();
+        }
+    };
+
+    template<SINK_TYPE Sink>
+    inline void from_json(std::string_view json, Sink& out)
+    {
+        const std::vector<uint32_t> sizes = json_container_sizes(json);
+        json_parser<Sink> parser(json, sizes, out);
+        parser.parse();
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+}
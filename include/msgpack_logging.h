@@ -0,0 +1,315 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+
+namespace msgpackcpp
+{
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Bounded ring of pre-allocated slots with any number of producers and a single consumer.
+    // Producers claim a slot with a CAS on the head counter and publish it with a release store:
+    // they never lock, allocate or make a syscall. A full ring or a record larger than a slot is dropped.
+    class mpsc_ring
+    {
+    public:
+        class slot_sink
+        {
+        private:
+            char*       data{};
+            std::size_t capacity{};
+            std::size_t len{0};
+            bool        overflow{false};
+
+        public:
+            slot_sink(char* data_, std::size_t capacity_);
+            void        operator()(const char* bytes, std::size_t nbytes);
+            std::size_t size()       const noexcept;
+            bool        overflowed() const noexcept;
+        };
+
+    private:
+        // Each slot's sequence counter sits on its own cache line: the consumer's release stores don't
+        // invalidate the line a producer is publishing to.
+        struct alignas(64) slot
+        {
+            std::atomic<std::size_t>    seq{0};
+            std::size_t                 size{0};
+        };
+
+        std::unique_ptr<slot[]>             slots;
+        std::unique_ptr<char[]>             storage;
+        std::size_t                         mask{};
+        std::size_t                         slot_capacity{};
+        alignas(64) std::atomic<std::size_t> head{0};
+        alignas(64) std::size_t              tail{0};
+        alignas(64) std::atomic<std::size_t> ndropped{0};
+
+    public:
+        mpsc_ring(std::size_t nslots, std::size_t slot_capacity_);
+
+        template<class Fn>
+        bool try_write(Fn&& fn);
+
+        template<class T>
+        bool push(const T& record);
+
+        template<SINK_TYPE Sink>
+        std::size_t drain(Sink& out, std::size_t max_records = std::numeric_limits<std::size_t>::max());
+
+        std::size_t nslots()    const noexcept;
+        std::size_t slot_size() const noexcept;
+        std::size_t dropped()   const noexcept;
+    };
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Structured logger: producers push msgpack records into an mpsc_ring, a background thread
+    // drains them in batches through a buffered_ostream, flushing whenever the ring runs empty.
+    // An idle consumer yields, then sleeps with a doubling backoff capped at idle_wait.
+    // The stream must only be touched by the logger until stop() returns.
+    class ring_logger
+    {
+    private:
+        mpsc_ring                   ring;
+        std::ostream&               file;
+        std::size_t                 batch{};
+        std::chrono::microseconds   idle_wait{};
+        std::atomic<bool>           running{true};
+        std::thread                 worker;
+
+        void run();
+
+    public:
+        ring_logger(std::ostream&               file_,
+                    std::size_t                 nslots          = 4096,
+                    std::size_t                 slot_capacity   = 512,
+                    std::size_t                 batch_          = 256,
+                    std::chrono::microseconds   idle_wait_      = std::chrono::microseconds(100));
+        ring_logger(const ring_logger&)             = delete;
+        ring_logger& operator=(const ring_logger&)  = delete;
+        ~ring_logger();
+
+        template<class T>
+        bool log(const T& record);
+
+        void        stop();
+        std::size_t dropped() const noexcept;
+    };
+
+//----------------------------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------------------------
+// DEFINITIONS
+//----------------------------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------------------------
+
+    inline mpsc_ring::slot_sink::slot_sink(char* data_, std::size_t capacity_)
+    : data{data_}, capacity{capacity_}
+    {
+    }
+
+    inline void mpsc_ring::slot_sink::operator()(const char* bytes, std::size_t nbytes)
+    {
+        if (overflow || (capacity - len) < nbytes)
+        {
+            overflow = true;
+            return;
+        }
+        std::memcpy(data + len, bytes, nbytes);
+        len += nbytes;
+    }
+
+    inline std::size_t mpsc_ring::slot_sink::size()       const noexcept { return len; }
+    inline bool        mpsc_ring::slot_sink::overflowed() const noexcept { return overflow; }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    inline mpsc_ring::mpsc_ring(std::size_t nslots_, std::size_t slot_capacity_)
+    : slot_capacity{slot_capacity_}
+    {
+        if (nslots_ < 2 || (nslots_ & (nslots_ - 1)) != 0)
+            throw std::invalid_argument("mpsc_ring: number of slots must be a power of 2");
+
+        slots   = std::make_unique<slot[]>(nslots_);
+        storage = std::make_unique<char[]>(nslots_ * slot_capacity);
+        mask    = nslots_ - 1;
+
+        for (std::size_t i = 0 ; i < nslots_ ; ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    template<class Fn>
+    inline bool mpsc_ring::try_write(Fn&& fn)
+    {
+        std::size_t pos = head.load(std::memory_order_relaxed);
+        slot*       s{};
+
+        for (;;)
+        {
+            s = &slots[pos & mask];
+            const std::size_t    seq = s->seq.load(std::memory_order_acquire);
+            const std::ptrdiff_t dif = static_cast<std::ptrdiff_t>(seq - pos);
+
+            if (dif == 0)
+            {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+            {
+                // Full
+                ndropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+                pos = head.load(std::memory_order_relaxed);
+        }
+
+        // The slot is claimed: it must be published whatever happens, otherwise the consumer stalls on it.
+        slot_sink out(&storage[(pos & mask) * slot_capacity], slot_capacity);
+        const auto publish = [&](std::size_t size) {
+            s->size = size;
+            s->seq.store(pos + 1, std::memory_order_release);
+        };
+
+        try
+        {
+            fn(out);
+        }
+        catch (...)
+        {
+            publish(0);
+            throw;
+        }
+
+        if (out.overflowed())
+        {
+            publish(0);
+            ndropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        publish(out.size());
+        return true;
+    }
+
+    template<class T>
+    inline bool mpsc_ring::push(const T& record)
+    {
+        return try_write([&](slot_sink& out) {
+            serialize(out, record);
+        });
+    }
+
+    template<SINK_TYPE Sink>
+    inline std::size_t mpsc_ring::drain(Sink& out, std::size_t max_records)
+    {
+        std::size_t n{0};
+
+        while (n < max_records)
+        {
+            slot& s = slots[tail & mask];
+            if (s.seq.load(std::memory_order_acquire) != tail + 1)
+                break;
+
+            // Empty slots are records that were dropped or threw while serializing
+            if (s.size > 0)
+            {
+                out(&storage[(tail & mask) * slot_capacity], s.size);
+                ++n;
+            }
+
+            s.seq.store(tail + mask + 1, std::memory_order_release);
+            ++tail;
+        }
+
+        return n;
+    }
+
+    inline std::size_t mpsc_ring::nslots()    const noexcept { return mask + 1; }
+    inline std::size_t mpsc_ring::slot_size() const noexcept { return slot_capacity; }
+    inline std::size_t mpsc_ring::dropped()   const noexcept { return ndropped.load(std::memory_order_relaxed); }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    inline ring_logger::ring_logger(std::ostream&               file_,
+                                    std::size_t                 nslots,
+                                    std::size_t                 slot_capacity,
+                                    std::size_t                 batch_,
+                                    std::chrono::microseconds   idle_wait_)
+    : ring{nslots, slot_capacity}, file{file_}, batch{batch_}, idle_wait{idle_wait_}
+    {
+        worker = std::thread([this] { run(); });
+    }
+
+    inline ring_logger::~ring_logger()
+    {
+        stop();
+    }
+
+    inline void ring_logger::run()
+    {
+        auto                        out = buffered_sink(file);
+        unsigned                    idle{0};
+        std::chrono::microseconds   backoff{1};
+
+        while (running.load(std::memory_order_acquire))
+        {
+            if (ring.drain(out, batch) > 0)
+            {
+                idle    = 0;
+                backoff = std::chrono::microseconds(1);
+            }
+            else if (idle++ == 0)
+            {
+                out.flush();
+                file.flush();
+            }
+            else if (idle < 16)
+                std::this_thread::yield();
+            else
+            {
+                std::this_thread::sleep_for(backoff);
+                backoff = std::min(backoff * 2, idle_wait);
+            }
+        }
+
+        // Producers may have published records after the last drain
+        while (ring.drain(out, batch) > 0) {}
+        out.flush();
+        file.flush();
+    }
+
+    template<class T>
+    inline bool ring_logger::log(const T& record)
+    {
+        return ring.push(record);
+    }
+
+    inline void ring_logger::stop()
+    {
+        running.store(false, std::memory_order_release);
+        if (worker.joinable())
+            worker.join();
+    }
+
+    inline std::size_t ring_logger::dropped() const noexcept
+    {
+        return ring.dropped();
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+}
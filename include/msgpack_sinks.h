@@ -1,9 +1,20 @@
 #pragma once
 
 #include <cstring>
+#include <exception>
+#include <utility>
+#include <memory>
+#include <stdexcept>
+#include <array>
 #include <vector>
 #include <ostream>
 #include <istream>
+#if __has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#define MSGPACK_HAS_IOVEC 1
+#else
+#define MSGPACK_HAS_IOVEC 0
+#endif
 #include "msgpack.h"
 
 namespace msgpackcpp
@@ -11,26 +22,265 @@ namespace msgpackcpp
 
 //----------------------------------------------------------------------------------------------------------------
 
-    template<class Byte, class Alloc, check_byte<Byte> = true>
-    auto sink(std::vector<Byte, Alloc>& buf)
+    // std::vector can only grow by value-initialising its new elements, so reserve() zero-fills the reservation
+    // before it is written. Capacity still grows geometrically, and commit() trims what wasn't used.
+    template<class Byte, class Alloc>
+    class vector_writer
     {
-        return [&](const char* bytes, size_t nbytes) {
+    private:
+        std::vector<Byte, Alloc>&   buf;
+        std::size_t                 start{0};
+
+    public:
+        explicit vector_writer(std::vector<Byte, Alloc>& buf_) : buf{buf_} {}
+
+        void operator()(const char* bytes, std::size_t nbytes)
+        {
             buf.insert(end(buf), bytes, bytes + nbytes);
-        };
-    } 
+        }
 
-    template<class Byte, class Alloc, check_byte<Byte> = true>
-    auto source(const std::vector<Byte, Alloc>& buf)
+        char* reserve(std::size_t nbytes)
+        {
+            start = buf.size();
+            buf.resize(start + nbytes);
+            return reinterpret_cast<char*>(buf.data() + start);
+        }
+
+        void commit(std::size_t nbytes)
+        {
+            buf.resize(start + nbytes);
+        }
+
+        std::size_t position() const noexcept {return buf.size();}
+    };
+
+    class memory_source
     {
-        size_t offset{0};
-        return [&buf, offset](char* bytes, size_t nbytes) mutable {
+    private:
+        const char* begin_{};
+        const char* ptr{};
+        std::size_t len{};
+
+    public:
+        memory_source(const char* data_, std::size_t size_) : begin_{data_}, ptr{data_}, len{size_} {}
+
+        void operator()(char* bytes, std::size_t nbytes)
+        {
+            if (len < nbytes)
+                throw std::system_error(OUT_OF_DATA);
+            std::memcpy(bytes, ptr, nbytes);
+            advance(nbytes);
+        }
+
+        const char* data()      const noexcept {return ptr;}
+        std::size_t remaining() const noexcept {return len;}
+        void        advance(std::size_t nbytes) noexcept {ptr += nbytes; len -= nbytes;}
+        std::size_t position()  const noexcept {return ptr - begin_;}
+    };
+
+    template<class Byte, class Alloc>
+    class vector_reader
+    {
+    private:
+        const std::vector<Byte, Alloc>& buf;
+        std::size_t                     offset{0};
+
+    public:
+        explicit vector_reader(const std::vector<Byte, Alloc>& buf_) : buf{buf_} {}
+
+        void operator()(char* bytes, std::size_t nbytes)
+        {
             if ((buf.size() - offset) < nbytes)
                 throw std::system_error(OUT_OF_DATA);
             std::memcpy(bytes, buf.data() + offset, nbytes);
             offset += nbytes;
-        };
+        }
+
+        const char* data()      const noexcept {return reinterpret_cast<const char*>(buf.data()) + offset;}
+        std::size_t remaining() const noexcept {return buf.size() - offset;}
+        void        advance(std::size_t nbytes) noexcept {offset += nbytes;}
+        std::size_t position()  const noexcept {return offset;}
+    };
+
+    template<class Byte, class Alloc, check_byte<Byte> = true>
+    auto sink(std::vector<Byte, Alloc>& buf)
+    {
+        return vector_writer<Byte, Alloc>(buf);
     } 
 
+    template<class Byte, class Alloc, check_byte<Byte> = true>
+    auto source(const std::vector<Byte, Alloc>& buf)
+    {
+        return vector_reader<Byte, Alloc>(buf);
+    } 
+
+    inline auto source(const char* data, std::size_t size)
+    {
+        return memory_source(data, size);
+    }
+
+    // Source over a frame which is known to be well-formed (e.g. produced by the same binary and
+    // checksummed at the framing layer). Reads and decoders are unchecked: bad input is undefined behaviour.
+    class trusted_reader
+    {
+    private:
+        const char* begin_{};
+        const char* ptr{};
+        const char* end{};
+
+    public:
+        static constexpr bool trusted = true;
+
+        trusted_reader(const char* data_, std::size_t size_) : begin_{data_}, ptr{data_}, end{data_ + size_} {}
+
+        void operator()(char* bytes, std::size_t nbytes) noexcept
+        {
+            std::memcpy(bytes, ptr, nbytes);
+            ptr += nbytes;
+        }
+
+        const char* data()      const noexcept {return ptr;}
+        std::size_t remaining() const noexcept {return end - ptr;}
+        void        advance(std::size_t nbytes) noexcept {ptr += nbytes;}
+        std::size_t position()  const noexcept {return ptr - begin_;}
+    };
+
+    inline auto trusted_source(const char* data, std::size_t size)
+    {
+        return trusted_reader(data, size);
+    }
+
+    // Only the frame length is checked, once, against the buffer
+    template<class Byte, class Alloc, check_byte<Byte> = true>
+    auto trusted_source(const std::vector<Byte, Alloc>& buf, std::size_t frame_size)
+    {
+        if (frame_size > buf.size())
+            throw std::system_error(OUT_OF_DATA);
+        return trusted_reader(reinterpret_cast<const char*>(buf.data()), frame_size);
+    }
+
+    template<class Byte, class Alloc, check_byte<Byte> = true>
+    auto trusted_source(const std::vector<Byte, Alloc>& buf)
+    {
+        return trusted_reader(reinterpret_cast<const char*>(buf.data()), buf.size());
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Sink writing to raw memory without any bounds checking. The caller guarantees the space, e.g. with
+    // max_encoded_size_for_v, which accounts for the encoding policy.
+    class unchecked_sink
+    {
+    private:
+        char* begin_{};
+        char* ptr{};
+
+    public:
+        explicit unchecked_sink(char* data) : begin_{data}, ptr{data} {}
+
+        void operator()(const char* bytes, std::size_t nbytes)
+        {
+            std::memcpy(ptr, bytes, nbytes);
+            ptr += nbytes;
+        }
+
+        std::size_t size()     const noexcept { return ptr - begin_; }
+        std::size_t position() const noexcept { return ptr - begin_; }
+    };
+
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Sink adapter selecting an encoding policy (see fixed_encoding). Forwards reserve/commit when the wrapped sink has them.
+    template<class Policy, class Sink>
+    class policy_sink
+    {
+    private:
+        Sink& out;
+
+    public:
+        using encoding_policy = Policy;
+
+        explicit policy_sink(Sink& out_) : out{out_} {}
+
+        void operator()(const char* bytes, std::size_t nbytes) { out(bytes, nbytes); }
+
+        template<class S = Sink>
+        auto reserve(std::size_t nbytes) -> decltype(std::declval<S&>().reserve(nbytes)) { return out.reserve(nbytes); }
+
+        template<class S = Sink>
+        auto commit(std::size_t nbytes) -> decltype(std::declval<S&>().commit(nbytes)) { return out.commit(nbytes); }
+
+        template<class S = Sink>
+        auto position() const noexcept -> decltype(std::declval<const S&>().position()) { return out.position(); }
+    };
+
+    template<class Policy, class Sink>
+    auto with_policy(Sink& out)
+    {
+        return policy_sink<Policy, Sink>(out);
+    }
+
+    template<class T, class Policy = minimal_encoding>
+    using encoded_buffer = std::array<char, max_encoded_size_for_v<T, Policy>>;
+
+    // Serializes a type with a bounded encoding into a stack buffer, with the given encoding policy.
+    // The capacity check happens at compile time.
+    template<class Policy = minimal_encoding, class T, std::size_t N>
+    std::size_t serialize_into(std::array<char, N>& buf, const T& obj)
+    {
+        static_assert(N >= max_encoded_size_for_v<T, Policy>, "buffer too small for the maximum encoded size of T");
+        unchecked_sink out(buf.data());
+        if constexpr (std::is_same_v<Policy, minimal_encoding>)
+        {
+            serialize(out, obj);
+        }
+        else
+        {
+            auto pout = with_policy<Policy>(out);
+            serialize(pout, obj);
+        }
+        return out.size();
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Non-owning type-erased sink and source. Code written against them is instantiated once instead of once per
+    // sink/source type, at the cost of an indirect call per write/read. The wrapped object must outlive them.
+    class any_sink
+    {
+    private:
+        void* obj{};
+        void (*write)(void*, const char*, std::size_t){};
+
+    public:
+        template<class Sink, std::enable_if_t<!std::is_same_v<Sink, any_sink>, bool> = true>
+        any_sink(Sink& out)
+        :   obj{&out},
+            write{[](void* o, const char* bytes, std::size_t nbytes) { (*static_cast<Sink*>(o))(bytes, nbytes); }}
+        {
+        }
+
+        void operator()(const char* bytes, std::size_t nbytes) { write(obj, bytes, nbytes); }
+    };
+
+    class any_source
+    {
+    private:
+        void* obj{};
+        void (*read)(void*, char*, std::size_t){};
+
+    public:
+        template<class Source, std::enable_if_t<!std::is_same_v<Source, any_source>, bool> = true>
+        any_source(Source& in)
+        :   obj{&in},
+            read{[](void* o, char* bytes, std::size_t nbytes) { (*static_cast<Source*>(o))(bytes, nbytes); }}
+        {
+        }
+
+        void operator()(char* bytes, std::size_t nbytes) { read(obj, bytes, nbytes); }
+    };
+
 //----------------------------------------------------------------------------------------------------------------
 
     inline auto sink(std::ostream& out)
@@ -49,6 +299,610 @@ namespace msgpackcpp
         };
     }
 
+//----------------------------------------------------------------------------------------------------------------
+
+    // Sink which batches writes into large sputn() calls on the stream buffer. Pending bytes are written by
+    // flush() and on destruction, unless the sink is destroyed by an exception. The destructor never throws: a failed
+    // write only sets badbit, even on streams with exceptions() enabled.
+    class buffered_ostream
+    {
+    private:
+        std::ostream&       out;
+        std::vector<char>   buf;
+        std::size_t         len{0};
+        std::vector<char>   spill;      // reservations larger than the buffer
+        bool                spilled{false};
+        int                 exceptions{std::uncaught_exceptions()};
+
+    public:
+        explicit buffered_ostream(std::ostream& out_, std::size_t capacity = 64*1024);
+        buffered_ostream(const buffered_ostream&)            = delete;
+        buffered_ostream& operator=(const buffered_ostream&) = delete;
+        ~buffered_ostream();
+
+        void  operator()(const char* bytes, std::size_t nbytes);
+        char* reserve(std::size_t nbytes);
+        void  commit(std::size_t nbytes);
+        void  flush();
+    };
+
+    // Source which refills an internal window with large sgetn() calls on the stream buffer.
+    // It reads ahead: on destruction, unconsumed bytes are given back by seeking if the stream supports it.
+    class buffered_istream
+    {
+    private:
+        std::istream&       in;
+        std::vector<char>   buf;
+        std::size_t         pos{0};
+        std::size_t         end{0};
+
+    public:
+        explicit buffered_istream(std::istream& in_, std::size_t capacity = 64*1024);
+        buffered_istream(const buffered_istream&)            = delete;
+        buffered_istream& operator=(const buffered_istream&) = delete;
+        ~buffered_istream();
+
+        void operator()(char* bytes, std::size_t nbytes);
+    };
+
+    inline buffered_ostream::buffered_ostream(std::ostream& out_, std::size_t capacity)
+    : out{out_}, buf(std::max<std::size_t>(capacity, 16))
+    {
+    }
+
+    inline buffered_ostream::~buffered_ostream()
+    {
+        if (std::uncaught_exceptions() != exceptions)
+            return;
+
+        try
+        {
+            flush();
+        }
+        catch (...)
+        {
+            // setstate() has recorded the failure before throwing
+        }
+    }
+
+    inline void buffered_ostream::flush()
+    {
+        if (len > 0 && out.rdbuf()->sputn(buf.data(), len) != (std::streamsize)len)
+            out.setstate(std::ios_base::badbit);
+        len = 0;
+    }
+
+    inline void buffered_ostream::operator()(const char* bytes, std::size_t nbytes)
+    {
+        if ((buf.size() - len) < nbytes)
+        {
+            flush();
+
+            if (nbytes >= buf.size())
+            {
+                if (out.rdbuf()->sputn(bytes, nbytes) != (std::streamsize)nbytes)
+                    out.setstate(std::ios_base::badbit);
+                return;
+            }
+        }
+
+        std::memcpy(buf.data() + len, bytes, nbytes);
+        len += nbytes;
+    }
+
+    inline char* buffered_ostream::reserve(std::size_t nbytes)
+    {
+        if ((buf.size() - len) < nbytes)
+            flush();
+
+        spilled = nbytes > buf.size();
+        if (spilled)
+        {
+            spill.resize(nbytes);
+            return spill.data();
+        }
+
+        return buf.data() + len;
+    }
+
+    inline void buffered_ostream::commit(std::size_t nbytes)
+    {
+        if (spilled)
+        {
+            if (out.rdbuf()->sputn(spill.data(), nbytes) != (std::streamsize)nbytes)
+                out.setstate(std::ios_base::badbit);
+        }
+        else
+            len += nbytes;
+    }
+
+    inline buffered_istream::buffered_istream(std::istream& in_, std::size_t capacity)
+    : in{in_}, buf(std::max<std::size_t>(capacity, 16))
+    {
+    }
+
+    inline buffered_istream::~buffered_istream()
+    {
+        if (pos < end)
+            in.rdbuf()->pubseekoff(-(std::streamoff)(end - pos), std::ios_base::cur, std::ios_base::in);
+    }
+
+    inline void buffered_istream::operator()(char* bytes, std::size_t nbytes)
+    {
+        if ((end - pos) >= nbytes)
+        {
+            std::memcpy(bytes, buf.data() + pos, nbytes);
+            pos += nbytes;
+            return;
+        }
+
+        // Drain the window then read the rest either straight into the destination or through a refill
+        const std::size_t avail = end - pos;
+        std::memcpy(bytes, buf.data() + pos, avail);
+        bytes  += avail;
+        nbytes -= avail;
+        pos = end = 0;
+
+        if (nbytes >= buf.size())
+        {
+            if (in.rdbuf()->sgetn(bytes, nbytes) != (std::streamsize)nbytes)
+            {
+                in.setstate(std::ios_base::eofbit | std::ios_base::failbit);
+                throw std::system_error(OUT_OF_DATA);
+            }
+            return;
+        }
+
+        end = in.rdbuf()->sgetn(buf.data(), buf.size());
+        if (end < nbytes)
+        {
+            in.setstate(std::ios_base::eofbit | std::ios_base::failbit);
+            throw std::system_error(OUT_OF_DATA);
+        }
+
+        std::memcpy(bytes, buf.data(), nbytes);
+        pos = nbytes;
+    }
+
+    inline auto buffered_sink(std::ostream& out, std::size_t capacity = 64*1024)
+    {
+        return buffered_ostream(out, capacity);
+    }
+
+    inline auto buffered_source(std::istream& in, std::size_t capacity = 64*1024)
+    {
+        return buffered_istream(in, capacity);
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Free list of fixed-size chunks shared by segmented buffers. Not thread-safe.
+    class chunk_pool
+    {
+    private:
+        std::size_t                             chunk_len{};
+        std::size_t                             max_free{};
+        std::vector<std::unique_ptr<char[]>>    free_chunks;
+
+    public:
+        explicit chunk_pool(std::size_t chunk_size = 64*1024, std::size_t max_free_chunks = 64);
+
+        std::size_t             chunk_size() const noexcept;
+        std::size_t             nfree()      const noexcept;
+        std::unique_ptr<char[]> acquire();
+        void                    release(std::unique_ptr<char[]> chunk);
+    };
+
+    // Output buffer made of pool chunks. Growing it never reallocates or copies what was already written.
+    // A moved-from buffer is empty, and creates a pool of its own if it is written to again.
+    class segmented_buffer
+    {
+    public:
+        struct segment
+        {
+            const char* data{};
+            std::size_t size{};
+        };
+
+    private:
+        struct chunk
+        {
+            std::unique_ptr<char[]> mem;
+            std::size_t             size{};
+        };
+
+        std::unique_ptr<chunk_pool> own_pool;
+        chunk_pool*                 pool{};
+        std::vector<chunk>          chunks;
+        std::size_t                 total{0};
+        std::vector<char>           spill;      // reservations that don't fit in the current chunk
+        bool                        spilled{false};
+
+    public:
+        explicit segmented_buffer(std::size_t chunk_size = 64*1024);
+        explicit segmented_buffer(chunk_pool& shared_pool);
+        segmented_buffer(segmented_buffer&& ori) noexcept;
+        segmented_buffer& operator=(segmented_buffer&& ori) noexcept;
+        ~segmented_buffer();
+
+        void        write(const char* data, std::size_t len);
+        char*       reserve(std::size_t len);
+        void        commit(std::size_t len);
+        void        clear();
+        std::size_t size()      const noexcept;
+        bool        empty()     const noexcept;
+        std::size_t nsegments() const noexcept;
+        segment     operator[](std::size_t i) const;
+
+        std::vector<segment> segments() const;
+#if MSGPACK_HAS_IOVEC
+        std::vector<iovec>   iovecs()   const;
+#endif
+    };
+
+    inline chunk_pool::chunk_pool(std::size_t chunk_size, std::size_t max_free_chunks)
+    : chunk_len{chunk_size}, max_free{max_free_chunks}
+    {
+        if (chunk_len == 0)
+            throw std::invalid_argument("chunk_pool: chunk size must be non-zero");
+    }
+
+    inline std::size_t chunk_pool::chunk_size() const noexcept { return chunk_len; }
+    inline std::size_t chunk_pool::nfree()      const noexcept { return free_chunks.size(); }
+
+    inline std::unique_ptr<char[]> chunk_pool::acquire()
+    {
+        if (free_chunks.empty())
+            return std::unique_ptr<char[]>(new char[chunk_len]);
+        auto chunk = std::move(free_chunks.back());
+        free_chunks.pop_back();
+        return chunk;
+    }
+
+    inline void chunk_pool::release(std::unique_ptr<char[]> chunk)
+    {
+        if (chunk && free_chunks.size() < max_free)
+            free_chunks.push_back(std::move(chunk));
+    }
+
+    inline segmented_buffer::segmented_buffer(std::size_t chunk_size)
+    : own_pool{std::make_unique<chunk_pool>(chunk_size)}, pool{own_pool.get()}
+    {
+    }
+
+    inline segmented_buffer::segmented_buffer(chunk_pool& shared_pool)
+    : pool{&shared_pool}
+    {
+    }
+
+    inline segmented_buffer::segmented_buffer(segmented_buffer&& ori) noexcept
+    :   own_pool{std::move(ori.own_pool)},
+        pool{std::exchange(ori.pool, nullptr)},
+        chunks{std::move(ori.chunks)},
+        total{std::exchange(ori.total, 0)},
+        spill{std::move(ori.spill)},
+        spilled{std::exchange(ori.spilled, false)}
+    {
+        ori.chunks.clear();
+    }
+
+    inline segmented_buffer& segmented_buffer::operator=(segmented_buffer&& ori) noexcept
+    {
+        if (this != &ori)
+        {
+            // Our chunks go back to our pool before it may be replaced
+            clear();
+            own_pool = std::move(ori.own_pool);
+            pool     = std::exchange(ori.pool, nullptr);
+            chunks   = std::move(ori.chunks);
+            total    = std::exchange(ori.total, 0);
+            spill    = std::move(ori.spill);
+            spilled  = std::exchange(ori.spilled, false);
+            ori.chunks.clear();
+        }
+        return *this;
+    }
+
+    inline segmented_buffer::~segmented_buffer()
+    {
+        clear();
+    }
+
+    inline void segmented_buffer::write(const char* data, std::size_t len)
+    {
+        if (!pool)
+        {
+            own_pool = std::make_unique<chunk_pool>();
+            pool     = own_pool.get();
+        }
+
+        const std::size_t chunk_size = pool->chunk_size();
+
+        while (len > 0)
+        {
+            if (chunks.empty() || chunks.back().size == chunk_size)
+                chunks.push_back({pool->acquire(), 0});
+
+            chunk& last = chunks.back();
+            const std::size_t n = std::min(len, chunk_size - last.size);
+            std::memcpy(last.mem.get() + last.size, data, n);
+            last.size += n;
+            total     += n;
+            data      += n;
+            len       -= n;
+        }
+    }
+
+    inline char* segmented_buffer::reserve(std::size_t len)
+    {
+        if (!chunks.empty() && (pool->chunk_size() - chunks.back().size) >= len)
+        {
+            spilled = false;
+            return chunks.back().mem.get() + chunks.back().size;
+        }
+
+        spilled = true;
+        spill.resize(len);
+        return spill.data();
+    }
+
+    inline void segmented_buffer::commit(std::size_t len)
+    {
+        if (spilled)
+        {
+            write(spill.data(), len);
+        }
+        else
+        {
+            chunks.back().size += len;
+            total              += len;
+        }
+    }
+
+    inline void segmented_buffer::clear()
+    {
+        if (pool)
+            for (auto& c : chunks)
+                pool->release(std::move(c.mem));
+        chunks.clear();
+        total = 0;
+    }
+
+    inline std::size_t segmented_buffer::size()      const noexcept { return total; }
+    inline bool        segmented_buffer::empty()     const noexcept { return total == 0; }
+    inline std::size_t segmented_buffer::nsegments() const noexcept { return chunks.size(); }
+
+    inline auto segmented_buffer::operator[](std::size_t i) const -> segment
+    {
+        return {chunks[i].mem.get(), chunks[i].size};
+    }
+
+    inline auto segmented_buffer::segments() const -> std::vector<segment>
+    {
+        std::vector<segment> segs(chunks.size());
+        for (std::size_t i = 0 ; i < chunks.size() ; ++i)
+            segs[i] = (*this)[i];
+        return segs;
+    }
+
+#if MSGPACK_HAS_IOVEC
+    inline std::vector<iovec> segmented_buffer::iovecs() const
+    {
+        std::vector<iovec> iovs(chunks.size());
+        for (std::size_t i = 0 ; i < chunks.size() ; ++i)
+        {
+            iovs[i].iov_base = chunks[i].mem.get();
+            iovs[i].iov_len  = chunks[i].size;
+        }
+        return iovs;
+    }
+#endif
+
+    class segmented_writer
+    {
+    private:
+        segmented_buffer& buf;
+
+    public:
+        explicit segmented_writer(segmented_buffer& buf_) : buf{buf_} {}
+
+        void  operator()(const char* bytes, std::size_t nbytes) { buf.write(bytes, nbytes); }
+        char* reserve(std::size_t nbytes)                       { return buf.reserve(nbytes); }
+        void  commit(std::size_t nbytes)                        { buf.commit(nbytes); }
+        std::size_t position() const noexcept                   { return buf.size(); }
+    };
+
+    inline auto sink(segmented_buffer& buf)
+    {
+        return segmented_writer(buf);
+    }
+
+    inline auto source(const segmented_buffer& buf)
+    {
+        size_t seg{0};
+        size_t offset{0};
+        size_t remaining{buf.size()};
+        return [&buf, seg, offset, remaining](char* bytes, size_t nbytes) mutable {
+            if (remaining < nbytes)
+                throw std::system_error(OUT_OF_DATA);
+            remaining -= nbytes;
+            while (nbytes > 0)
+            {
+                const auto s = buf[seg];
+                const size_t n = std::min(nbytes, s.size - offset);
+                std::memcpy(bytes, s.data + offset, n);
+                bytes   += n;
+                nbytes  -= n;
+                offset  += n;
+                if (offset == s.size)
+                {
+                    ++seg;
+                    offset = 0;
+                }
+            }
+        };
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Recycles message buffers so that steady-state serialization doesn't allocate.
+    // A pool is not thread-safe: use buffer_pool::local() and release leases on the thread that acquired them.
+    class buffer_pool
+    {
+    public:
+        struct statistics
+        {
+            std::size_t hits{0};        // acquire() served from a recycled buffer
+            std::size_t misses{0};      // acquire() had to allocate
+            std::size_t dropped{0};     // released buffers freed because of the retention bound
+            std::size_t leased{0};      // buffers currently leased
+            std::size_t high_water{0};  // maximum number of buffers leased at once
+        };
+
+        class lease
+        {
+        private:
+            buffer_pool*        pool{};
+            std::vector<char>   buf;
+
+        public:
+            lease() = default;
+            lease(buffer_pool& pool_, std::vector<char> buf_);
+            lease(lease&& ori) noexcept;
+            lease& operator=(lease&& ori) noexcept;
+            lease(const lease&)            = delete;
+            lease& operator=(const lease&) = delete;
+            ~lease();
+
+            std::vector<char>&       get()       noexcept;
+            const std::vector<char>& get() const noexcept;
+            void                     release();
+        };
+
+    private:
+        std::vector<std::vector<char>>  free_buffers;
+        std::size_t                     initial_capacity{};
+        std::size_t                     max_retained{};
+        std::size_t                     retained{0};
+        statistics                      stats_{};
+
+        void recycle(std::vector<char>&& buf);
+
+    public:
+        explicit buffer_pool(std::size_t initial_capacity_ = 4096, std::size_t max_retained_bytes = 4*1024*1024);
+
+        lease               acquire();
+        const statistics&   stats()          const noexcept;
+        std::size_t         retained_bytes() const noexcept;
+        void                trim();
+
+        static buffer_pool& local();
+    };
+
+    inline buffer_pool::lease::lease(buffer_pool& pool_, std::vector<char> buf_)
+    : pool{&pool_}, buf{std::move(buf_)}
+    {
+    }
+
+    inline buffer_pool::lease::lease(lease&& ori) noexcept
+    : pool{std::exchange(ori.pool, nullptr)}, buf{std::move(ori.buf)}
+    {
+    }
+
+    inline auto buffer_pool::lease::operator=(lease&& ori) noexcept -> lease&
+    {
+        if (this != &ori)
+        {
+            release();
+            pool = std::exchange(ori.pool, nullptr);
+            buf  = std::move(ori.buf);
+        }
+        return *this;
+    }
+
+    inline buffer_pool::lease::~lease()
+    {
+        release();
+    }
+
+    inline std::vector<char>&       buffer_pool::lease::get()       noexcept { return buf; }
+    inline const std::vector<char>& buffer_pool::lease::get() const noexcept { return buf; }
+
+    inline void buffer_pool::lease::release()
+    {
+        if (pool)
+            std::exchange(pool, nullptr)->recycle(std::move(buf));
+    }
+
+    inline buffer_pool::buffer_pool(std::size_t initial_capacity_, std::size_t max_retained_bytes)
+    : initial_capacity{initial_capacity_}, max_retained{max_retained_bytes}
+    {
+    }
+
+    inline auto buffer_pool::acquire() -> lease
+    {
+        std::vector<char> buf;
+
+        if (!free_buffers.empty())
+        {
+            buf = std::move(free_buffers.back());
+            free_buffers.pop_back();
+            retained -= buf.capacity();
+            ++stats_.hits;
+        }
+        else
+        {
+            buf.reserve(initial_capacity);
+            ++stats_.misses;
+        }
+
+        ++stats_.leased;
+        stats_.high_water = std::max(stats_.high_water, stats_.leased);
+        return lease(*this, std::move(buf));
+    }
+
+    inline void buffer_pool::recycle(std::vector<char>&& buf)
+    {
+        --stats_.leased;
+        buf.clear();
+
+        if (retained + buf.capacity() <= max_retained)
+        {
+            retained += buf.capacity();
+            free_buffers.push_back(std::move(buf));
+        }
+        else
+        {
+            ++stats_.dropped;
+            std::vector<char>{}.swap(buf);
+        }
+    }
+
+    inline auto buffer_pool::stats()          const noexcept -> const statistics& { return stats_; }
+    inline auto buffer_pool::retained_bytes() const noexcept -> std::size_t       { return retained; }
+
+    inline void buffer_pool::trim()
+    {
+        free_buffers.clear();
+        retained = 0;
+    }
+
+    inline buffer_pool& buffer_pool::local()
+    {
+        static thread_local buffer_pool pool;
+        return pool;
+    }
+
+    inline auto sink(buffer_pool::lease& buf)
+    {
+        return sink(buf.get());
+    }
+
+    inline auto source(const buffer_pool::lease& buf)
+    {
+        return source(buf.get());
+    }
+
 //----------------------------------------------------------------------------------------------------------------
 
 }
\ No newline at end of file
@@ -0,0 +1,454 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include "msgpack.h"
+
+namespace msgpackcpp
+{
+
+//----------------------------------------------------------------------------------------------------------------
+
+    enum format_family : uint8_t
+    {
+        FAMILY_NIL,
+        FAMILY_BOOL,
+        FAMILY_FIXINT,
+        FAMILY_U8,
+        FAMILY_U16,
+        FAMILY_U32,
+        FAMILY_U64,
+        FAMILY_I8,
+        FAMILY_I16,
+        FAMILY_I32,
+        FAMILY_I64,
+        FAMILY_F32,
+        FAMILY_F64,
+        FAMILY_FIXSTR,
+        FAMILY_STR8,
+        FAMILY_STR16,
+        FAMILY_STR32,
+        FAMILY_BIN8,
+        FAMILY_BIN16,
+        FAMILY_BIN32,
+        FAMILY_FIXARR,
+        FAMILY_ARR16,
+        FAMILY_ARR32,
+        FAMILY_FIXMAP,
+        FAMILY_MAP16,
+        FAMILY_MAP32,
+        FAMILY_OTHER,   // ext types and the reserved format 0xc1
+        NUM_FORMAT_FAMILIES
+    };
+
+    const char* format_family_name(format_family f);
+
+    // Number of objects and encoded bytes per format family. Strings and binary arrays include their payload,
+    // arrays and maps only their header. Strings and other objects used as map keys are also counted in map_keys.
+    struct format_stats
+    {
+        struct entry
+        {
+            uint64_t count{0};
+            uint64_t bytes{0};
+        };
+
+        std::array<entry, NUM_FORMAT_FAMILIES>  families{};
+        entry                                   map_keys{};
+        uint64_t                                total_bytes{0};
+
+        format_stats& operator+=(const format_stats& other);
+
+        // Prints a table of the non-empty families with their share of the total bytes
+        void print(std::ostream& out) const;
+    };
+
+    // Classification of a format byte
+    struct format_info
+    {
+        enum kind_t : uint8_t {SCALAR, PAYLOAD, ARRAY, MAP};
+
+        format_family   family{FAMILY_OTHER};
+        kind_t          kind{SCALAR};
+        uint8_t         header_size{1};     // format byte + length/value/type bytes
+        uint8_t         length_bytes{0};    // big-endian length or container size following the format byte
+        uint8_t         fixed_size{0};      // payload of fixstr/fixext, number of elements of fixarray/fixmap
+    };
+
+    // Incremental tokenizer which classifies an encoded stream fed in chunks of any size.
+    // Headers are decoded in place when a chunk holds them whole and payloads are skipped in bulk.
+    class format_counter
+    {
+    private:
+        struct container
+        {
+            uint64_t remaining{};
+            bool     is_map{};
+        };
+
+        format_stats            stats_;
+        std::vector<container>  stack;
+        const format_info*      info{};
+        char                    header[9]{};
+        uint8_t                 header_len{0};
+        bool                    is_key{false};
+        uint64_t                payload{0};
+
+        void begin_object(uint8_t format);
+        void end_header(const char* hdr);
+        void add_bytes(uint64_t nbytes);
+
+    public:
+        void consume(const char* data, std::size_t nbytes);
+
+        const format_stats& stats() const noexcept;
+        void                reset();
+    };
+
+    // Sink and source decorators which count what passes through them. The contiguous capabilities, position(),
+    // encoding policy and trust of the wrapped sink or source are forwarded, so wrapping doesn't change the encoding
+    // and the fast (de)serialization paths stay enabled.
+    template<class Sink>
+    class stats_sink
+    {
+    private:
+        Sink&           out;
+        format_counter  counter;
+        char*           reserved{};
+
+    public:
+        using encoding_policy = sink_encoding_policy_t<Sink>;
+
+        explicit stats_sink(Sink& out_) : out{out_} {}
+
+        void operator()(const char* bytes, std::size_t nbytes);
+
+        template<class S = Sink, std::enable_if_t<is_contiguous_sink_v<S>, bool> = true>
+        char* reserve(std::size_t nbytes);
+
+        template<class S = Sink, std::enable_if_t<is_contiguous_sink_v<S>, bool> = true>
+        void commit(std::size_t nbytes);
+
+        template<class S = Sink>
+        auto position() const noexcept -> decltype(std::declval<const S&>().position()) { return out.position(); }
+
+        const format_stats& stats() const noexcept { return counter.stats(); }
+        void                reset()                { counter.reset(); }
+    };
+
+    template<class Source>
+    class stats_source
+    {
+    private:
+        Source&         in;
+        format_counter  counter;
+
+    public:
+        static constexpr bool trusted = is_trusted_source_v<Source>;
+
+        explicit stats_source(Source& in_) : in{in_} {}
+
+        void operator()(char* bytes, std::size_t nbytes);
+
+        template<class S = Source, std::enable_if_t<is_contiguous_source_v<S>, bool> = true>
+        const char* data() const noexcept { return in.data(); }
+
+        template<class S = Source, std::enable_if_t<is_contiguous_source_v<S>, bool> = true>
+        std::size_t remaining() const noexcept { return in.remaining(); }
+
+        template<class S = Source, std::enable_if_t<is_contiguous_source_v<S>, bool> = true>
+        void advance(std::size_t nbytes);
+
+        template<class S = Source>
+        auto position() const noexcept -> decltype(std::declval<const S&>().position()) { return in.position(); }
+
+        const format_stats& stats() const noexcept { return counter.stats(); }
+        void                reset()                { counter.reset(); }
+    };
+
+    template<class Sink>
+    auto with_stats(Sink& out) -> std::enable_if_t<std::is_invocable_v<Sink&, const char*, std::size_t>, stats_sink<Sink>>;
+
+    template<class Source>
+    auto with_stats(Source& in) -> std::enable_if_t<!std::is_invocable_v<Source&, const char*, std::size_t>, stats_source<Source>>;
+
+//----------------------------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------------------------
+// DEFINITIONS
+//----------------------------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------------------------
+
+    inline const char* format_family_name(format_family f)
+    {
+        static constexpr const char* names[NUM_FORMAT_FAMILIES] = {
+            "nil", "bool", "fixint", "uint8", "uint16", "uint32", "uint64", "int8", "int16", "int32", "int64",
+            "float32", "float64", "fixstr", "str8", "str16", "str32", "bin8", "bin16", "bin32",
+            "fixarray", "array16", "array32", "fixmap", "map16", "map32", "other"
+        };
+        return f < NUM_FORMAT_FAMILIES ? names[f] : "?";
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    inline format_stats& format_stats::operator+=(const format_stats& other)
+    {
+        for (std::size_t i = 0 ; i < families.size() ; ++i)
+        {
+            families[i].count += other.families[i].count;
+            families[i].bytes += other.families[i].bytes;
+        }
+        map_keys.count += other.map_keys.count;
+        map_keys.bytes += other.map_keys.bytes;
+        total_bytes    += other.total_bytes;
+        return *this;
+    }
+
+    inline void format_stats::print(std::ostream& out) const
+    {
+        const auto flags     = out.flags();
+        const auto precision = out.precision();
+
+        const auto row = [&](const char* name, const entry& e) {
+            const double share = total_bytes > 0 ? 100.0 * e.bytes / total_bytes : 0.0;
+            out << std::left  << std::setw(10) << name
+                << std::right << std::setw(14) << e.count
+                << std::setw(16) << e.bytes
+                << std::setw(9)  << std::fixed << std::setprecision(1) << share << " %\n";
+        };
+
+        out << std::left  << std::setw(10) << "family"
+            << std::right << std::setw(14) << "count"
+            << std::setw(16) << "bytes"
+            << std::setw(11) << "share" << '\n';
+
+        for (std::size_t i = 0 ; i < families.size() ; ++i)
+            if (families[i].count > 0)
+                row(format_family_name(static_cast<format_family>(i)), families[i]);
+
+        if (map_keys.count > 0)
+            row("map keys", map_keys);
+
+        out << std::left << std::setw(10) << "total" << std::right << std::setw(30) << total_bytes << '\n';
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    constexpr std::array<format_info, 256> make_format_table()
+    {
+        std::array<format_info, 256> table{};
+
+        const auto set = [&](uint8_t f, format_family family, format_info::kind_t kind, uint8_t length_bytes, uint8_t extra = 0) {
+            table[f] = {family, kind, static_cast<uint8_t>(1 + length_bytes + extra), length_bytes, 0};
+        };
+
+        for (int f = 0 ; f < 256 ; ++f)
+        {
+            const uint8_t b = static_cast<uint8_t>(f);
+            if (b <= MSGPACK_FIXINT_POS || b >= MSGPACK_FIXINT_NEG)
+                table[b] = {FAMILY_FIXINT, format_info::SCALAR, 1, 0, 0};
+            else if (format_is_fixstr(b))
+                table[b] = {FAMILY_FIXSTR, format_info::PAYLOAD, 1, 0, static_cast<uint8_t>(b & 0b00011111)};
+            else if (format_is_fixarr(b))
+                table[b] = {FAMILY_FIXARR, format_info::ARRAY, 1, 0, static_cast<uint8_t>(b & 0b00001111)};
+            else if (format_is_fixmap(b))
+                table[b] = {FAMILY_FIXMAP, format_info::MAP, 1, 0, static_cast<uint8_t>(b & 0b00001111)};
+        }
+
+        set(MSGPACK_NIL,   FAMILY_NIL,   format_info::SCALAR,  0);
+        set(MSGPACK_FALSE, FAMILY_BOOL,  format_info::SCALAR,  0);
+        set(MSGPACK_TRUE,  FAMILY_BOOL,  format_info::SCALAR,  0);
+        set(MSGPACK_U8,    FAMILY_U8,    format_info::SCALAR,  0, 1);
+        set(MSGPACK_U16,   FAMILY_U16,   format_info::SCALAR,  0, 2);
+        set(MSGPACK_U32,   FAMILY_U32,   format_info::SCALAR,  0, 4);
+        set(MSGPACK_U64,   FAMILY_U64,   format_info::SCALAR,  0, 8);
+        set(MSGPACK_I8,    FAMILY_I8,    format_info::SCALAR,  0, 1);
+        set(MSGPACK_I16,   FAMILY_I16,   format_info::SCALAR,  0, 2);
+        set(MSGPACK_I32,   FAMILY_I32,   format_info::SCALAR,  0, 4);
+        set(MSGPACK_I64,   FAMILY_I64,   format_info::SCALAR,  0, 8);
+        set(MSGPACK_F32,   FAMILY_F32,   format_info::SCALAR,  0, 4);
+        set(MSGPACK_F64,   FAMILY_F64,   format_info::SCALAR,  0, 8);
+        set(MSGPACK_STR8,  FAMILY_STR8,  format_info::PAYLOAD, 1);
+        set(MSGPACK_STR16, FAMILY_STR16, format_info::PAYLOAD, 2);
+        set(MSGPACK_STR32, FAMILY_STR32, format_info::PAYLOAD, 4);
+        set(MSGPACK_BIN8,  FAMILY_BIN8,  format_info::PAYLOAD, 1);
+        set(MSGPACK_BIN16, FAMILY_BIN16, format_info::PAYLOAD, 2);
+        set(MSGPACK_BIN32, FAMILY_BIN32, format_info::PAYLOAD, 4);
+        set(MSGPACK_ARR16, FAMILY_ARR16, format_info::ARRAY,   2);
+        set(MSGPACK_ARR32, FAMILY_ARR32, format_info::ARRAY,   4);
+        set(MSGPACK_MAP16, FAMILY_MAP16, format_info::MAP,     2);
+        set(MSGPACK_MAP32, FAMILY_MAP32, format_info::MAP,     4);
+
+        // ext 8/16/32: length then type byte. fixext 1/2/4/8/16: type byte then 1-16 bytes of data
+        set(0xc7, FAMILY_OTHER, format_info::PAYLOAD, 1, 1);
+        set(0xc8, FAMILY_OTHER, format_info::PAYLOAD, 2, 1);
+        set(0xc9, FAMILY_OTHER, format_info::PAYLOAD, 4, 1);
+        for (uint8_t i = 0 ; i < 5 ; ++i)
+            table[0xd4 + i] = {FAMILY_OTHER, format_info::PAYLOAD, 2, 0, static_cast<uint8_t>(1 << i)};
+
+        return table;
+    }
+
+    inline constexpr std::array<format_info, 256> format_table = make_format_table();
+
+    inline void format_counter::begin_object(uint8_t format)
+    {
+        while (!stack.empty() && stack.back().remaining == 0)
+            stack.pop_back();
+
+        is_key = false;
+        if (!stack.empty())
+        {
+            container& top = stack.back();
+            is_key = top.is_map && top.remaining % 2 == 0;
+            --top.remaining;
+        }
+
+        info = &format_table[format];
+        ++stats_.families[info->family].count;
+        if (is_key)
+            ++stats_.map_keys.count;
+    }
+
+    inline void format_counter::end_header(const char* hdr)
+    {
+        uint64_t size = info->fixed_size;
+        for (uint8_t i = 0 ; i < info->length_bytes ; ++i)
+            size = (size << 8) | static_cast<uint8_t>(hdr[1 + i]);
+
+        switch(info->kind)
+        {
+        case format_info::PAYLOAD:  payload = size;                 break;
+        case format_info::ARRAY:    stack.push_back({size, false}); break;
+        case format_info::MAP:      stack.push_back({2 * size, true}); break;
+        default:                                                    break;
+        }
+    }
+
+    inline void format_counter::add_bytes(uint64_t nbytes)
+    {
+        stats_.families[info->family].bytes += nbytes;
+        stats_.total_bytes                  += nbytes;
+        if (is_key)
+            stats_.map_keys.bytes += nbytes;
+    }
+
+    inline void format_counter::consume(const char* data, std::size_t nbytes)
+    {
+        while (nbytes > 0)
+        {
+            if (payload > 0)
+            {
+                const std::size_t n = static_cast<std::size_t>(std::min<uint64_t>(payload, nbytes));
+                add_bytes(n);
+                payload -= n;
+                data    += n;
+                nbytes  -= n;
+                continue;
+            }
+
+            if (header_len == 0)
+            {
+                begin_object(static_cast<uint8_t>(data[0]));
+
+                // Common case: the whole header is in this chunk
+                if (nbytes >= info->header_size)
+                {
+                    end_header(data);
+                    add_bytes(info->header_size);
+                    data   += info->header_size;
+                    nbytes -= info->header_size;
+                    continue;
+                }
+            }
+
+            const std::size_t n = std::min<std::size_t>(info->header_size - header_len, nbytes);
+            std::memcpy(header + header_len, data, n);
+            header_len += static_cast<uint8_t>(n);
+            add_bytes(n);
+            data   += n;
+            nbytes -= n;
+
+            if (header_len == info->header_size)
+            {
+                header_len = 0;
+                end_header(header);
+            }
+        }
+    }
+
+    inline const format_stats& format_counter::stats() const noexcept
+    {
+        return stats_;
+    }
+
+    inline void format_counter::reset()
+    {
+        stats_      = {};
+        stack.clear();
+        info        = nullptr;
+        header_len  = 0;
+        payload     = 0;
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    template<class Sink>
+    inline void stats_sink<Sink>::operator()(const char* bytes, std::size_t nbytes)
+    {
+        counter.consume(bytes, nbytes);
+        out(bytes, nbytes);
+    }
+
+    template<class Sink>
+    template<class S, std::enable_if_t<is_contiguous_sink_v<S>, bool>>
+    inline char* stats_sink<Sink>::reserve(std::size_t nbytes)
+    {
+        reserved = out.reserve(nbytes);
+        return reserved;
+    }
+
+    template<class Sink>
+    template<class S, std::enable_if_t<is_contiguous_sink_v<S>, bool>>
+    inline void stats_sink<Sink>::commit(std::size_t nbytes)
+    {
+        counter.consume(reserved, nbytes);
+        out.commit(nbytes);
+    }
+
+    template<class Source>
+    inline void stats_source<Source>::operator()(char* bytes, std::size_t nbytes)
+    {
+        in(bytes, nbytes);
+        counter.consume(bytes, nbytes);
+    }
+
+    template<class Source>
+    template<class S, std::enable_if_t<is_contiguous_source_v<S>, bool>>
+    inline void stats_source<Source>::advance(std::size_t nbytes)
+    {
+        counter.consume(in.data(), nbytes);
+        in.advance(nbytes);
+    }
+
+    template<class Sink>
+    inline auto with_stats(Sink& out) -> std::enable_if_t<std::is_invocable_v<Sink&, const char*, std::size_t>, stats_sink<Sink>>
+    {
+        return stats_sink<Sink>(out);
+    }
+
+    template<class Source>
+    inline auto with_stats(Source& in) -> std::enable_if_t<!std::is_invocable_v<Source&, const char*, std::size_t>, stats_source<Source>>
+    {
+        return stats_source<Source>(in);
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+}
@@ -0,0 +1,391 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <initializer_list>
+#include <vector>
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+
+namespace msgpackcpp
+{
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Byte range of an encoded object
+    struct encoded_object
+    {
+        std::size_t offset{0};
+        std::size_t size{0};
+    };
+
+    // Non-owning view of one encoded object
+    class object_view
+    {
+    private:
+        const char* ptr{};
+        std::size_t len{0};
+
+    public:
+        object_view() = default;
+        object_view(const char* data_, std::size_t size_);
+
+        const char* data()      const noexcept;
+        std::size_t size()      const noexcept;
+        uint8_t     format()    const noexcept;
+
+        bool is_null()  const noexcept;
+        bool is_bool()  const noexcept;
+        bool is_int()   const noexcept;
+        bool is_real()  const noexcept;
+        bool is_str()   const noexcept;
+        bool is_bin()   const noexcept;
+        bool is_array() const noexcept;
+        bool is_map()   const noexcept;
+
+        // Points into the buffer, throws BAD_FORMAT if not a string
+        std::string_view as_str() const;
+
+        // Decodes the object into T
+        template<class T>
+        T as() const;
+    };
+
+    // Size in bytes of the first encoded object in [data, data + size)
+    std::size_t encoded_size(const char* data, std::size_t size);
+
+    // Finds the object at the end of a path. Map keys are matched against string keys only.
+    // Returns an empty optional if a step doesn't exist, throws on malformed input.
+    std::optional<encoded_object> locate(const char* data, std::size_t size, path p);
+
+    template<class Byte, class Alloc, check_byte<Byte> = true>
+    std::optional<encoded_object> locate(const std::vector<Byte, Alloc>& buf, path p);
+
+    // Same with a JSON pointer (RFC 6901) such as "/object/currency" or "/list/2": tokens index arrays when the
+    // object at that point is an array and are map keys otherwise. "" is the whole buffer.
+    std::optional<object_view> find(const char* data, std::size_t size, std::string_view pointer);
+
+    template<class Byte, class Alloc, check_byte<Byte> = true>
+    std::optional<object_view> find(const std::vector<Byte, Alloc>& buf, std::string_view pointer);
+
+    // Overwrites the scalar (integer, float, bool) at a path with v, keeping its encoded width.
+    // Returns false, leaving the buffer untouched, if the path doesn't exist, the object there is of
+    // a different kind or v doesn't fit in its width.
+    template<class T>
+    bool patch(char* data, std::size_t size, path p, const T& v);
+
+    // Same as above, but when v doesn't fit in place the object is re-encoded and the tail of the buffer shifted.
+    // Returns false only if the path doesn't exist.
+    template<class Byte, class Alloc, class T, check_byte<Byte> = true>
+    bool patch(std::vector<Byte, Alloc>& buf, path p, const T& v);
+
+//----------------------------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------------------------
+// DEFINITIONS
+//----------------------------------------------------------------------------------------------------------------
+//----------------------------------------------------------------------------------------------------------------
+
+    inline std::size_t encoded_size(const char* data, std::size_t size)
+    {
+        memory_source in(data, size);
+        skip(in);
+        return size - in.remaining();
+    }
+
+    // Moves the source to the item at index of the array it points to. False if the index doesn't exist.
+    inline bool enter_index(memory_source& in, const uint32_t index)
+    {
+        uint32_t nitems{};
+        deserialize_array_size(in, nitems);
+        if (index >= nitems)
+            return false;
+
+        for (uint32_t i = 0 ; i < index ; ++i)
+            skip(in);
+        return true;
+    }
+
+    // Moves the source to the value of key in the map it points to. False if the key doesn't exist.
+    // Keys are compared on their raw encoded bytes: length first, then memcmp.
+    inline bool enter_key(memory_source& in, const std::string_view key)
+    {
+        uint32_t nitems{};
+        deserialize_map_size(in, nitems);
+
+        for (uint32_t i = 0 ; i < nitems ; ++i)
+        {
+            if (in.remaining() > 0 && format_is_string(static_cast<uint8_t>(in.data()[0])))
+            {
+                uint32_t len{};
+                deserialize_str_size(in, len);
+                if (in.remaining() < len)
+                    throw std::system_error(OUT_OF_DATA);
+                const bool found = len == key.size() && std::memcmp(in.data(), key.data(), len) == 0;
+                in.advance(len);
+                if (found)
+                    return true;
+            }
+            else
+                skip(in);
+
+            skip(in);
+        }
+
+        return false;
+    }
+
+    inline uint8_t peek_format(const memory_source& in)
+    {
+        if (in.remaining() == 0)
+            throw std::system_error(OUT_OF_DATA);
+        return static_cast<uint8_t>(in.data()[0]);
+    }
+
+    inline std::optional<encoded_object> locate(const char* data, std::size_t size, path p)
+    {
+        memory_source in(data, size);
+
+        for (const path_element& step : p)
+        {
+            const uint8_t format = peek_format(in);
+
+            if (step.is_index ? !format_is_array(format) || !enter_index(in, step.index)
+                              : !format_is_map(format)   || !enter_key(in, step.key))
+                return std::nullopt;
+        }
+
+        const char* begin = in.data();
+        skip(in);
+        return encoded_object{static_cast<std::size_t>(begin - data), static_cast<std::size_t>(in.data() - begin)};
+    }
+
+    template<class Byte, class Alloc, check_byte<Byte>>
+    inline std::optional<encoded_object> locate(const std::vector<Byte, Alloc>& buf, path p)
+    {
+        return locate(reinterpret_cast<const char*>(buf.data()), buf.size(), p);
+    }
+
+    inline std::optional<object_view> find(const char* data, std::size_t size, std::string_view pointer)
+    {
+        if (!pointer.empty() && pointer[0] != '/')
+            throw std::invalid_argument("msgpackcpp::find: JSON pointer must be empty or start with '/'");
+
+        memory_source in(data, size);
+        std::string   unescaped;
+
+        while (!pointer.empty())
+        {
+            pointer.remove_prefix(1);
+            const std::size_t end   = std::min(pointer.find('/'), pointer.size());
+            std::string_view  token = pointer.substr(0, end);
+            pointer.remove_prefix(end);
+
+            if (token.find('~') != std::string_view::npos)
+            {
+                unescaped.clear();
+                for (std::size_t i = 0 ; i < token.size() ; ++i)
+                {
+                    if (token[i] == '~' && i + 1 < token.size() && (token[i+1] == '0' || token[i+1] == '1'))
+                        unescaped += token[++i] == '0' ? '~' : '/';
+                    else
+                        unescaped += token[i];
+                }
+                token = unescaped;
+            }
+
+            const uint8_t format = peek_format(in);
+
+            if (format_is_array(format))
+            {
+                uint64_t index{0};
+                if (token.empty() || token.size() > 10 || (token.size() > 1 && token[0] == '0'))
+                    return std::nullopt;
+                for (const char c : token)
+                {
+                    if (c < '0' || c > '9')
+                        return std::nullopt;
+                    index = index * 10 + (c - '0');
+                }
+                if (index > std::numeric_limits<uint32_t>::max() || !enter_index(in, static_cast<uint32_t>(index)))
+                    return std::nullopt;
+            }
+            else if (!format_is_map(format) || !enter_key(in, token))
+                return std::nullopt;
+        }
+
+        const char* begin = in.data();
+        skip(in);
+        return object_view(begin, static_cast<std::size_t>(in.data() - begin));
+    }
+
+    template<class Byte, class Alloc, check_byte<Byte>>
+    inline std::optional<object_view> find(const std::vector<Byte, Alloc>& buf, std::string_view pointer)
+    {
+        return find(reinterpret_cast<const char*>(buf.data()), buf.size(), pointer);
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    inline object_view::object_view(const char* data_, std::size_t size_) : ptr{data_}, len{size_} {}
+
+    inline const char* object_view::data()      const noexcept {return ptr;}
+    inline std::size_t object_view::size()      const noexcept {return len;}
+    inline uint8_t     object_view::format()    const noexcept {return len > 0 ? static_cast<uint8_t>(ptr[0]) : 0;}
+
+    inline bool object_view::is_null()  const noexcept {return len > 0 && format() == MSGPACK_NIL;}
+    inline bool object_view::is_bool()  const noexcept {return len > 0 && format_is_bool(format());}
+    inline bool object_view::is_int()   const noexcept {return len > 0 && int_decodings[format()].valid;}
+    inline bool object_view::is_real()  const noexcept {return len > 0 && (format() == MSGPACK_F32 || format() == MSGPACK_F64);}
+    inline bool object_view::is_str()   const noexcept {return len > 0 && format_is_string(format());}
+    inline bool object_view::is_bin()   const noexcept {return len > 0 && format_is_binary(format());}
+    inline bool object_view::is_array() const noexcept {return len > 0 && format_is_array(format());}
+    inline bool object_view::is_map()   const noexcept {return len > 0 && format_is_map(format());}
+
+    inline std::string_view object_view::as_str() const
+    {
+        if (!is_str())
+            throw std::system_error(BAD_FORMAT);
+        memory_source in(ptr, len);
+        uint32_t size{};
+        deserialize_str_size(in, size);
+        if (in.remaining() < size)
+            throw std::system_error(OUT_OF_DATA);
+        return std::string_view(in.data(), size);
+    }
+
+    template<class T>
+    inline T object_view::as() const
+    {
+        T obj{};
+        memory_source in(ptr, len);
+        deserialize(in, obj);
+        return obj;
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+    // Encodes an integer with exactly len bytes in the family (signed/unsigned) of the existing format when possible
+    template<class Int>
+    inline bool encode_int_in_place(char* buf, const std::size_t len, const uint8_t old_format, const Int v)
+    {
+        const uint64_t bits     = static_cast<uint64_t>(v);
+        bool           negative{false};
+        if constexpr (std::is_signed_v<Int>)
+            negative = v < 0;
+        const int      width    = bit_width64(negative ? ~bits : bits);
+        const int      nbits    = 8 * static_cast<int>(len - 1);
+
+        if (len == 1)
+        {
+            if ((negative && width > 5) || (!negative && width > 7))
+                return false;
+            buf[0] = static_cast<char>(bits);
+            return true;
+        }
+
+        const bool fits_unsigned = !negative && width <= nbits;
+        const bool fits_signed   = width < nbits;
+        const bool was_unsigned  = old_format >= MSGPACK_U8 && old_format <= MSGPACK_U64;
+
+        if (!fits_unsigned && !fits_signed)
+            return false;
+
+        const bool     as_unsigned = fits_unsigned && (was_unsigned || !fits_signed);
+        const uint64_t shifted     = bits << (64 - nbits);
+
+        switch(len)
+        {
+        case 2: buf[0] = as_unsigned ? MSGPACK_U8  : MSGPACK_I8;  break;
+        case 3: buf[0] = as_unsigned ? MSGPACK_U16 : MSGPACK_I16; break;
+        case 5: buf[0] = as_unsigned ? MSGPACK_U32 : MSGPACK_I32; break;
+        case 9: buf[0] = as_unsigned ? MSGPACK_U64 : MSGPACK_I64; break;
+        default: return false;
+        }
+
+        // Big-endian payload: the top len - 1 bytes of the shifted value
+        char tmp[8];
+        store(tmp, host_to_b64(shifted));
+        std::memcpy(&buf[1], tmp, len - 1);
+        return true;
+    }
+
+    template<class T>
+    inline bool encode_in_place(char* buf, const std::size_t len, const T& v)
+    {
+        const uint8_t format = static_cast<uint8_t>(buf[0]);
+
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            if (!format_is_bool(format))
+                return false;
+            buf[0] = v ? MSGPACK_TRUE : MSGPACK_FALSE;
+            return true;
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            if (!int_decodings[format].valid)
+                return false;
+            return encode_int_in_place(buf, len, format, v);
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            if (format == MSGPACK_F64)
+            {
+                encode(buf, static_cast<double>(v));
+                return true;
+            }
+            else if (format == MSGPACK_F32 && static_cast<T>(static_cast<float>(v)) == v)
+            {
+                encode(buf, static_cast<float>(v));
+                return true;
+            }
+            return false;
+        }
+        else
+        {
+            static_assert(std::is_arithmetic_v<T>, "only scalars can be patched");
+            return false;
+        }
+    }
+
+    template<class T>
+    inline bool patch(char* data, std::size_t size, path p, const T& v)
+    {
+        const auto obj = locate(data, size, p);
+        return obj && encode_in_place(data + obj->offset, obj->size, v);
+    }
+
+    template<class Byte, class Alloc, class T, check_byte<Byte>>
+    inline bool patch(std::vector<Byte, Alloc>& buf, path p, const T& v)
+    {
+        const auto obj = locate(buf, p);
+        if (!obj)
+            return false;
+
+        char* data = reinterpret_cast<char*>(buf.data());
+        if (encode_in_place(data + obj->offset, obj->size, v))
+            return true;
+
+        // Splice: re-encode with the smallest format and move the tail once
+        std::vector<char> tmp;
+        auto out = sink(tmp);
+        serialize(out, v);
+
+        const auto first = buf.begin() + obj->offset;
+        if (tmp.size() > obj->size)
+            buf.insert(first + obj->size, tmp.size() - obj->size, Byte{});
+        else
+            buf.erase(first + tmp.size(), first + obj->size);
+        std::memcpy(buf.data() + obj->offset, tmp.data(), tmp.size());
+        return true;
+    }
+
+//----------------------------------------------------------------------------------------------------------------
+
+}
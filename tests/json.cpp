@@ -0,0 +1,152 @@
+#include <random>
+#include "doctest.h"
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+#include "msgpack_json.h"
+
+using namespace std;
+using namespace msgpackcpp;
+
+TEST_SUITE("[JSON]") 
+{
+    TEST_CASE("msgpack to json")
+    {
+        value jv = {
+            {"pi", 3.141},
+            {"happy", true},
+            {"name", "Niels"},
+            {"nothing", nullptr},
+            {"answer", {
+                {"everything", -42}
+            }},
+            {"list", {1, 0, 2}},
+            {"empty", std::vector<value>{}},
+            {"object", {
+                {"currency", "USD"},
+                {"value", 42.99}
+            }}
+        };
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        jv.pack(out);
+
+        // std::map orders the keys
+        const std::string expected = R"({"answer":{"everything":-42},"empty":[],"happy":true,"list":[1,0,2],"name":"Niels","nothing":null,)"
+                                     R"("object":{"currency":"USD","value":42.99},"pi":3.141})";
+        REQUIRE(to_json(buf) == expected);
+
+        // Plain callable source and sink
+        std::string str;
+        size_t offset{0};
+        auto in   = [&](char* bytes, size_t nbytes) {std::memcpy(bytes, buf.data() + offset, nbytes); offset += nbytes;};
+        auto out2 = [&](const char* bytes, size_t nbytes) {str.append(bytes, nbytes);};
+        to_json(in, out2);
+        REQUIRE(str == expected);
+
+        // Truncated input: the buffered output isn't flushed while the exception unwinds
+        str.clear();
+        auto in3 = source(buf.data(), buf.size() - 1);
+        REQUIRE_THROWS_AS(to_json(in3, out2), std::system_error);
+        REQUIRE(str.empty());
+    }
+
+    TEST_CASE("scalars, escapes and binary")
+    {
+        const auto check = [](const auto& obj, const std::string& expected) {
+            std::vector<char> buf;
+            auto out = sink(buf);
+            serialize(out, obj);
+            REQUIRE(to_json(buf) == expected);
+        };
+
+        check(1.0, "1.0");
+        check(-0.5f, "-0.5");
+        check(std::numeric_limits<double>::infinity(), "null");
+        check(std::numeric_limits<uint64_t>::max(), "18446744073709551615");
+        check(std::numeric_limits<int64_t>::min(), "-9223372036854775808");
+        check("a\"b\\c\n\x01 long enough to take the 8-byte path /"s, R"("a\"b\\c\n\u0001 long enough to take the 8-byte path /")");
+        check("caf\xc3\xa9"s, "\"caf\xc3\xa9\"");
+        check(std::vector<uint8_t>{0, 255, 7}, "[0,255,7]");
+        check(std::map<int, bool>{{1, true}, {-2, false}}, R"({"-2":false,"1":true})");
+        check(std::make_tuple(std::vector<int>{}, std::map<std::string, int>{}), "[[],{}]");
+    }
+
+    TEST_CASE("json to msgpack")
+    {
+        const std::string json = R"( { "pi" : 3.141, "happy":true, "name":"Niels", "nothing":null,
+                                      "answer":{"everything":-42}, "list":[1,0,2,[],{}],
+                                      "big": 18446744073709551615, "bigger": 1e300, "huge": 184467440737095516150,
+                                      "esc":"tab\there \u00e9 \ud83d\ude00 \"q\" \\ \/" } )";
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        from_json(json, out);
+
+        auto in = source(buf);
+        value jv = unpack(in);
+        REQUIRE(in.remaining() == 0);
+        REQUIRE(jv.at("pi").as_real() == 3.141);
+        REQUIRE(jv.at("happy").as_bool() == true);
+        REQUIRE(jv.at("name").as_str() == "Niels");
+        REQUIRE(jv.at("nothing").is_null());
+        REQUIRE(jv.at("answer").at("everything").as_int64() == -42);
+        REQUIRE(jv.at("list").as_array().size() == 5);
+        REQUIRE(jv.at("list").as_array()[3].as_array().empty());
+        REQUIRE(jv.at("big").as_uint64() == std::numeric_limits<uint64_t>::max());
+        REQUIRE(jv.at("bigger").as_real() == 1e300);
+        REQUIRE(jv.at("huge").as_real() == 184467440737095516150.0);
+        REQUIRE(jv.at("esc").as_str() == "tab\there \xc3\xa9 \xf0\x9f\x98\x80 \"q\" \\ /");
+
+        // And back
+        std::vector<char> buf2;
+        auto out2 = sink(buf2);
+        from_json(to_json(buf), out2);
+        REQUIRE(buf2 == buf);
+
+        for (const char* bad : {"", "[1,2", "[1,,2]", "{\"a\" 1}", "{1:2}", "tru", "01", "1.", "\"\\x\"", "[1] 2", "]", "\"\\ud800\""})
+        {
+            std::vector<char> tmp;
+            auto out3 = sink(tmp);
+            REQUIRE_THROWS_AS(from_json(bad, out3), std::system_error);
+        }
+
+        // Numbers out of the range of double
+        std::vector<char> buf4;
+        auto out4 = sink(buf4);
+        from_json("[1e400,-1e400,1e-400]", out4);
+        auto  in4 = source(buf4);
+        value jv4 = unpack(in4);
+        REQUIRE(jv4[0].as_real() == std::numeric_limits<double>::infinity());
+        REQUIRE(jv4[1].as_real() == -std::numeric_limits<double>::infinity());
+        REQUIRE(jv4[2].as_real() == 0.0);
+    }
+
+    TEST_CASE("round trip")
+    {
+        std::mt19937 eng(std::random_device{}());
+        std::uniform_int_distribution<int64_t> dist;
+        std::uniform_real_distribution<double> real(-1e6, 1e6);
+
+        for (int repeat = 0 ; repeat < 100 ; ++repeat)
+        {
+            std::map<std::string, value> m;
+            for (int i = 0 ; i < 10 ; ++i)
+            {
+                std::string key(1 + (eng() % 20), ' ');
+                for (auto& c : key)
+                    c = static_cast<char>(1 + eng() % 127);
+                m[key] = value(std::vector<value>{value(dist(eng)), value(real(eng)), value(key), value(nullptr)});
+            }
+
+            std::vector<char> buf;
+            auto out = sink(buf);
+            value(m).pack(out);
+
+            std::vector<char> buf2;
+            auto out2 = sink(buf2);
+            from_json(to_json(buf), out2);
+            REQUIRE(buf2 == buf);
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include "doctest.h"
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+#include "msgpack_logging.h"
+
+using namespace std;
+using namespace msgpackcpp;
+
+TEST_SUITE("[LOGGING]") 
+{
+    TEST_CASE("ring")
+    {
+        mpsc_ring ring(4, 16);
+        REQUIRE(ring.nslots() == 4);
+
+        REQUIRE(ring.push(std::make_tuple(1, "one")));
+        REQUIRE(ring.push(std::make_tuple(2, "two")));
+        REQUIRE(!ring.push(std::string(100, 'x')));    // doesn't fit in a slot
+        REQUIRE(ring.push(std::make_tuple(3, "three")));
+        REQUIRE(!ring.push(std::make_tuple(4, "four"))); // full
+        REQUIRE(ring.dropped() == 2);
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        REQUIRE(ring.drain(out) == 3);
+        REQUIRE(ring.drain(out) == 0);
+        REQUIRE(ring.push(std::make_tuple(4, "four")));
+        REQUIRE(ring.drain(out) == 1);
+
+        auto in = source(buf);
+        for (int i = 1 ; i <= 4 ; ++i)
+        {
+            std::tuple<int, std::string> record;
+            deserialize(in, record);
+            REQUIRE(std::get<0>(record) == i);
+        }
+
+        REQUIRE_THROWS_AS(mpsc_ring(3, 16), std::invalid_argument);
+    }
+
+    TEST_CASE("logger")
+    {
+        constexpr int nthreads = 4;
+        constexpr int nrecords = 5000;
+
+        std::stringstream file;
+        size_t dropped{};
+
+        {
+            ring_logger logger(file, 1024, 64);
+
+            std::vector<std::thread> producers;
+            for (int t = 0 ; t < nthreads ; ++t)
+                producers.emplace_back([&, t] {
+                    for (int i = 0 ; i < nrecords ; ++i)
+                        logger.log(std::make_tuple(t, i, "some message"));
+                });
+
+            for (auto& p : producers)
+                p.join();
+
+            logger.stop();
+            dropped = logger.dropped();
+        }
+
+        // Records from one producer arrive in order
+        std::vector<int> last(nthreads, -1);
+        size_t received{0};
+        const std::string str = file.str();
+        std::vector<char> buf(begin(str), end(str));
+        auto in = source(buf);
+
+        while (received + dropped < nthreads * nrecords)
+        {
+            std::tuple<int, int, std::string> record;
+            deserialize(in, record);
+            const auto [t, i, msg] = record;
+            REQUIRE(i > last[t]);
+            REQUIRE(msg == "some message");
+            last[t] = i;
+            ++received;
+        }
+
+        REQUIRE_THROWS_AS(deserialize(in, last), std::system_error);
+    }
+
+    TEST_CASE("logger flushes when idle")
+    {
+        // Counts bytes reaching the stream buffer, so the test can observe them while the worker runs
+        struct counting_buf : std::streambuf
+        {
+            std::atomic<size_t> nbytes{0};
+            std::streamsize xsputn(const char*, std::streamsize n) override { nbytes += n; return n; }
+            int_type overflow(int_type c) override { ++nbytes; return c; }
+        };
+
+        counting_buf buf;
+        std::ostream file(&buf);
+        ring_logger  logger(file, 64, 64, 256, std::chrono::microseconds(500));
+
+        REQUIRE(logger.log(std::make_tuple(1, "idle")));
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (buf.nbytes == 0 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        // Written before stop(): the worker flushed its buffer once the ring was empty
+        REQUIRE(buf.nbytes > 0);
+        logger.stop();
+    }
+}
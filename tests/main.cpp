@@ -1,2 +1,6 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
-#include "doctest.h"
\ No newline at end of file
+#include "doctest.h"
+
+// Compiles the instantiations which msgpack_extern.h declares extern in the other test files
+#define MSGPACK_INSTANTIATE_TEMPLATES
+#include "msgpack_extern.h"
@@ -120,6 +120,16 @@ namespace custom_namespace
                 std::equal(begin(a.my_vec), end(a.my_vec), begin(b.my_vec)) &&
                 a.my_struct     == b.my_struct;
     }
+
+    struct tick
+    {
+        uint64_t                timestamp{};
+        int32_t                 price{};
+        uint32_t                volume{};
+        std::array<uint8_t, 4>  flags{};
+    };
+
+    BOOST_DESCRIBE_STRUCT(tick, (), (timestamp, price, volume, flags))
 }
 
 TEST_SUITE("[PACK]") 
@@ -532,4 +542,249 @@ TEST_SUITE("[PACK]")
             REQUIRE((c == cc) == true);
         }
     }
+
+    TEST_CASE("integer widths")
+    {
+        // Boundaries of every integer format and the expected encoded size
+        const std::vector<std::pair<int64_t, size_t>> sints = {
+            {0, 1}, {127, 1}, {128, 2}, {255, 2}, {256, 3}, {65535, 3}, {65536, 5},
+            {4294967295ll, 5}, {4294967296ll, 9}, {std::numeric_limits<int64_t>::max(), 9},
+            {-1, 1}, {-32, 1}, {-33, 2}, {-128, 2}, {-129, 3}, {-32768, 3}, {-32769, 5},
+            {std::numeric_limits<int32_t>::min(), 5}, {std::numeric_limits<int32_t>::min() - 1ll, 9},
+            {std::numeric_limits<int64_t>::min(), 9}
+        };
+
+        for (const auto& [v, len] : sints)
+        {
+            std::vector<char> buf;
+            auto out = sink(buf);
+            serialize(out, v);
+            REQUIRE(buf.size() == len);
+
+            // Narrow contiguous, wide contiguous and plain callable sources
+            int64_t v0{}, v1{}, v2{};
+            auto in0 = source(buf);
+            deserialize(in0, v0);
+            buf.resize(buf.size() + 16);
+            auto in1 = source(buf);
+            deserialize(in1, v1);
+            REQUIRE(in1.remaining() == 16);
+            size_t off{0};
+            auto in2 = [&](char* bytes, size_t nbytes) {std::memcpy(bytes, buf.data() + off, nbytes); off += nbytes;};
+            deserialize(in2, v2);
+            REQUIRE(v0 == v);
+            REQUIRE(v1 == v);
+            REQUIRE(v2 == v);
+        }
+
+        const uint64_t u = std::numeric_limits<uint64_t>::max();
+        std::vector<char> buf;
+        auto out = sink(buf);
+        serialize(out, u);
+        REQUIRE(buf.size() == 9);
+        REQUIRE(uint8_t(buf[0]) == 0xcf);
+        uint64_t uu{};
+        auto in = source(buf);
+        deserialize(in, uu);
+        REQUIRE(uu == u);
+
+        // Bad formats are still rejected
+        const std::vector<char> bad(16, char(0xc1));
+        auto in3 = source(bad);
+        REQUIRE_THROWS_AS(deserialize(in3, uu), std::system_error);
+    }
+
+    TEST_CASE("fixed encoding")
+    {
+        static_assert(uses_fixed_encoding<policy_sink<fixed_encoding, unchecked_sink>>);
+        static_assert(!uses_fixed_encoding<unchecked_sink>);
+
+        std::vector<char> buf0;
+        auto out0 = sink(buf0);
+        auto out  = with_policy<fixed_encoding>(out0);
+        static_assert(is_contiguous_sink_v<decltype(out)>);
+
+        // Every field has a value-independent width
+        const auto a = std::make_tuple(uint8_t{0}, int16_t{-1}, uint32_t{7}, int64_t{1}, 1.0f, "hi"s);
+        serialize(out, a);
+        REQUIRE(buf0.size() == 5 + 2 + 3 + 5 + 9 + 5 + 5 + 2);
+        REQUIRE(uint8_t(buf0[0])  == 0xdd);    // array 32
+        REQUIRE(uint8_t(buf0[5])  == 0xcc);    // uint 8
+        REQUIRE(uint8_t(buf0[7])  == 0xd1);    // int 16
+        REQUIRE(uint8_t(buf0[10]) == 0xce);    // uint 32
+        REQUIRE(uint8_t(buf0[15]) == 0xd3);    // int 64
+        REQUIRE(uint8_t(buf0[29]) == 0xdb);    // str 32
+
+        // Patch the uint32 in place and decode with the default policy
+        const uint32_t patched = 0xdeadbeef;
+        store(&buf0[11], host_to_b32(patched));
+        std::decay_t<decltype(a)> aa{};
+        auto in = source(buf0);
+        deserialize(in, aa);
+        REQUIRE(std::get<2>(aa) == patched);
+        REQUIRE(std::get<1>(aa) == -1);
+        REQUIRE(std::get<5>(aa) == "hi");
+
+        // Arrays decode with strided loads, mixed widths fall back to the regular path
+        std::mt19937 eng(std::random_device{}());
+        std::vector<int32_t> v(1000);
+        std::array<uint16_t, 17> w;
+        for (auto& x : v) x = random_int<int32_t>(eng);
+        for (auto& x : w) x = random_int<uint16_t>(eng);
+
+        for (const bool fixed : {true, false})
+        {
+            std::vector<char> buf;
+            auto out1 = sink(buf);
+            auto out2 = with_policy<fixed_encoding>(out1);
+            if (fixed)
+            {
+                serialize(out2, v);
+                serialize(out2, w);
+                REQUIRE(buf.size() == 5 + v.size()*5 + 5 + w.size()*3);
+            }
+            else
+            {
+                serialize(out1, v);
+                serialize(out1, w);
+            }
+
+            std::vector<int32_t>        vv;
+            std::array<uint16_t, 17>    ww{};
+            auto in1 = source(buf);
+            deserialize(in1, vv);
+            deserialize(in1, ww);
+            REQUIRE(vv == v);
+            REQUIRE(ww == w);
+        }
+
+        // long double has no msgpack format of its own and is kept off the bulk paths
+        static_assert(!is_packed_arithmetic<long double>);
+        static_assert(is_packed_arithmetic<double> && is_packed_arithmetic<int8_t>);
+    }
+
+    TEST_CASE("canonical encoding")
+    {
+        static_assert(uses_canonical_encoding<policy_sink<canonical_encoding, unchecked_sink>>);
+        static_assert(uses_canonical_encoding<hash_sink>);
+        static_assert(!uses_fixed_encoding<policy_sink<canonical_encoding, unchecked_sink>>);
+
+        const auto encode = [](const auto& obj) {
+            std::vector<char> buf;
+            auto out0 = sink(buf);
+            auto out  = with_policy<canonical_encoding>(out0);
+            serialize(out, obj);
+            return buf;
+        };
+
+        // Unordered maps are written in key order, whatever the insertion order or bucket count
+        std::unordered_map<std::string, int> a, b(1024);
+        std::map<std::string, int>           c;
+        for (int i = 0 ; i < 100 ; ++i)
+        {
+            a["key" + std::to_string(i)]      = i;
+            b["key" + std::to_string(99 - i)] = 99 - i;
+            c["key" + std::to_string(i)]      = i;
+        }
+        REQUIRE(encode(a) == encode(b));
+        REQUIRE(encode(a) == encode(c));
+
+        std::vector<char> plain;
+        auto out = sink(plain);
+        serialize(out, c);
+        REQUIRE(encode(c) == plain);
+
+        // Integers are minimal whatever their type, NaNs are all the same
+        REQUIRE(encode(int64_t{5}) == encode(uint8_t{5}));
+        REQUIRE(encode(int64_t{-300}) == encode(int16_t{-300}));
+        const double nan1 = std::numeric_limits<double>::quiet_NaN();
+        const double nan2 = -std::numeric_limits<double>::signaling_NaN();
+        REQUIRE(encode(nan1) == encode(nan2));
+        REQUIRE(encode(std::vector<double>{1.0, nan2}) == encode(std::vector<double>{1.0, nan1}));
+        REQUIRE(encode(std::vector<float>{nan2}) == encode(std::vector<float>{std::numeric_limits<float>::quiet_NaN()}));
+        REQUIRE(encode(0.0) != encode(-0.0));
+
+        // Hashing the canonical encoding
+        hash_sink h1, h2, h3;
+        serialize(h1, a);
+        serialize(h2, b);
+        serialize(h3, std::map<std::string, int>{{"key0", 1}});
+        REQUIRE(h1.digest() == h2.digest());
+        REQUIRE(h1.digest() != h3.digest());
+    }
+
+    TEST_CASE("max encoded size")
+    {
+        static_assert(max_encoded_size_v<bool>      == 1);
+        static_assert(max_encoded_size_v<uint8_t>   == 2);
+        static_assert(max_encoded_size_v<int32_t>   == 5);
+        static_assert(max_encoded_size_v<uint64_t>  == 9);
+        static_assert(max_encoded_size_v<float>     == 5);
+        static_assert(max_encoded_size_v<double>    == 9);
+        static_assert(max_encoded_size_v<std::array<char, 300>>    == 303);
+        static_assert(max_encoded_size_v<std::array<int16_t, 20>>  == 3 + 20*3);
+        static_assert(max_encoded_size_v<std::tuple<int, double>>  == 1 + 5 + 9);
+        static_assert(max_encoded_headers_v<double> == 0);
+        static_assert(max_encoded_headers_v<std::array<char, 300>> == 1);
+        static_assert(max_encoded_headers_v<std::tuple<int, std::array<std::array<char, 3>, 2>>> == 1 + 1 + 2);
+        static_assert(max_encoded_size_for_v<std::tuple<int, std::array<char, 20>>> == 1 + 5 + 22);
+        static_assert(max_encoded_size_for_v<std::tuple<int, std::array<char, 20>>, fixed_encoding> == 1 + 5 + 22 + 8);
+        static_assert(!has_max_encoded_headers_v<std::string>);
+        static_assert(max_encoded_str_size(31) == 32);
+        static_assert(max_encoded_str_size(32) == 34);
+        static_assert(!has_max_encoded_size_v<std::string>);
+        static_assert(!has_max_encoded_size_v<std::vector<int>>);
+        static_assert(!has_max_encoded_size_v<std::tuple<int, std::string>>);
+        static_assert(!has_max_encoded_size_v<custom_namespace::custom_struct1>);
+
+        // as_map = true is the larger bound: each key costs a fixstr header plus its characters
+        using custom_namespace::tick;
+        static_assert(max_encoded_size_v<tick> == 1 + (10 + 9) + (6 + 5) + (7 + 5) + (6 + 6));
+
+        std::mt19937 eng(std::random_device{}());
+
+        for (int repeat = 0 ; repeat < 1000 ; ++repeat)
+        {
+            tick t;
+            t.timestamp = random_int<uint64_t>(eng);
+            t.price     = random_int<int32_t>(eng);
+            t.volume    = random_int<uint32_t>(eng);
+            t.flags     = {random_int<uint8_t>(eng), 0, 1, 2};
+
+            for (const bool as_map : {false, true})
+            {
+                encoded_buffer<tick> buf;
+                unchecked_sink out0(buf.data());
+                serialize(out0, t, as_map);
+                REQUIRE(out0.size() <= buf.size());
+
+                std::vector<char> buf2;
+                auto out1 = sink(buf2);
+                serialize(out1, t, as_map);
+                REQUIRE(buf2.size() == out0.size());
+                REQUIRE(std::equal(begin(buf2), end(buf2), begin(buf)));
+
+                // fixed_encoding widens every header, which the policy-aware bound accounts for
+                encoded_buffer<tick, fixed_encoding> fbuf;
+                unchecked_sink out2(fbuf.data());
+                auto fout = with_policy<fixed_encoding>(out2);
+                serialize(fout, t, as_map);
+                REQUIRE(out2.size() > out0.size());
+                REQUIRE(out2.size() <= fbuf.size());
+            }
+
+            auto packed   = std::make_tuple(t.timestamp, t.price, t.volume);
+            decltype(packed) unpacked{};
+            encoded_buffer<decltype(packed)> buf;
+            const size_t len = serialize_into(buf, packed);
+            std::vector<char> buf2(begin(buf), begin(buf) + len);
+            auto in = source(buf2);
+            deserialize(in, unpacked);
+            REQUIRE(packed == unpacked);
+
+            const auto nested = std::make_tuple(t.price, t.flags, std::array<std::array<char, 3>, 2>{});
+            encoded_buffer<decltype(nested), fixed_encoding> fbuf;
+            REQUIRE(serialize_into<fixed_encoding>(fbuf, nested) <= fbuf.size());
+        }
+    }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "doctest.h"
 #include "msgpack.h"
 #include "msgpack_sinks.h"
+#include "msgpack_extern.h"
 
 using namespace std;
 using namespace std::literals::string_view_literals;
@@ -34,4 +35,341 @@ TEST_SUITE("[SINKS]")
         REQUIRE(buf0.size() == buf1_str.size());
         REQUIRE(std::equal(begin(buf0), end(buf0), begin(buf1_str)));
     }
-}
\ No newline at end of file
+
+    TEST_CASE("segmented buffer")
+    {
+        std::vector<int> a(100);
+        std::iota(begin(a), end(a), 0);
+        std::map<std::string, int> b = {{"a", 1}, {"b", 2}};
+        std::string c(200, 'x');
+
+        std::vector<char> buf0;
+        chunk_pool        pool(16);
+        segmented_buffer  buf1(pool);
+
+        const auto run = [&](auto& buf)
+        {
+            auto out = sink(buf);
+            serialize(out, a);
+            serialize(out, b);
+            serialize(out, c);
+        };
+
+        run(buf0);
+        run(buf1);
+        REQUIRE(buf1.size() == buf0.size());
+        REQUIRE(buf1.nsegments() == (buf0.size() + 15) / 16);
+
+        std::string joined;
+        for (const auto& seg : buf1.segments())
+            joined.append(seg.data, seg.size);
+        REQUIRE(std::equal(begin(buf0), end(buf0), begin(joined)));
+
+#if MSGPACK_HAS_IOVEC
+        const auto iovs = buf1.iovecs();
+        REQUIRE(iovs.size() == buf1.nsegments());
+        REQUIRE(iovs[0].iov_len == 16);
+#endif
+
+        std::vector<int>            aa;
+        std::map<std::string, int>  bb;
+        std::string                 cc;
+        auto in = source(buf1);
+        deserialize(in, aa);
+        deserialize(in, bb);
+        deserialize(in, cc);
+        REQUIRE(a == aa);
+        REQUIRE(b == bb);
+        REQUIRE(c == cc);
+        REQUIRE_THROWS_AS(deserialize(in, cc), std::system_error);
+
+        // Chunks go back to the pool and are reused
+        const size_t nsegments = buf1.nsegments();
+        buf1.clear();
+        REQUIRE(buf1.empty());
+        REQUIRE(pool.nfree() == nsegments);
+        run(buf1);
+        REQUIRE(pool.nfree() == 0);
+
+        // Moving hands the chunks over and leaves an empty buffer which owns nothing
+        segmented_buffer buf2(std::move(buf1));
+        REQUIRE(buf1.empty());
+        REQUIRE(buf1.nsegments() == 0);
+        REQUIRE(buf2.size() == buf0.size());
+        buf1.clear();
+        REQUIRE(pool.nfree() == 0);
+
+        // It can be written to again, through a pool of its own
+        run(buf1);
+        REQUIRE(buf1.size() == buf0.size());
+        REQUIRE(pool.nfree() == 0);
+
+        // Assignment returns the target's chunks to its pool first
+        segmented_buffer buf3(pool);
+        run(buf3);
+        const size_t nsegments3 = buf3.nsegments();
+        buf3 = std::move(buf2);
+        REQUIRE(pool.nfree() == nsegments3);
+        REQUIRE(buf3.size() == buf0.size());
+        REQUIRE(buf2.empty());
+        buf2 = segmented_buffer(pool);
+        run(buf2);
+        REQUIRE(buf2.size() == buf0.size());
+    }
+
+    TEST_CASE("buffer pool")
+    {
+        std::vector<int> a(100);
+        std::iota(begin(a), end(a), 0);
+
+        buffer_pool pool(256, 1024);
+
+        for (int i = 0 ; i < 10 ; ++i)
+        {
+            auto buf = pool.acquire();
+            REQUIRE(buf.get().empty());
+            auto out = sink(buf);
+            serialize(out, a);
+
+            std::vector<int> aa;
+            auto in = source(buf);
+            deserialize(in, aa);
+            REQUIRE(a == aa);
+        }
+
+        REQUIRE(pool.stats().misses == 1);
+        REQUIRE(pool.stats().hits == 9);
+        REQUIRE(pool.stats().leased == 0);
+        REQUIRE(pool.stats().high_water == 1);
+        REQUIRE(pool.retained_bytes() >= 256);
+
+        {
+            auto buf0 = pool.acquire();
+            auto buf1 = pool.acquire();
+            auto buf2 = std::move(buf1);
+            REQUIRE(pool.stats().leased == 2);
+            REQUIRE(pool.stats().high_water == 2);
+            buf2.get().resize(4096);
+        }
+
+        // The 4096-byte buffer exceeds the retention bound and is freed
+        REQUIRE(pool.stats().leased == 0);
+        REQUIRE(pool.stats().dropped == 1);
+        REQUIRE(pool.retained_bytes() <= 1024);
+
+        auto& local = buffer_pool::local();
+        REQUIRE(&local == &buffer_pool::local());
+    }
+
+    TEST_CASE("buffered streams")
+    {
+        std::vector<int> a(100);
+        std::iota(begin(a), end(a), 0);
+        std::map<std::string, int> b = {{"a", 1}, {"b", 2}};
+        std::string c(1000, 'x');
+
+        std::vector<char> buf0;
+        std::stringstream buf1;
+
+        {
+            auto out = sink(buf0);
+            serialize(out, a);
+            serialize(out, b);
+            serialize(out, c);
+        }
+
+        {
+            auto out = buffered_sink(buf1, 64);
+            serialize(out, a);
+            serialize(out, b);
+            serialize(out, c);
+        }
+
+        std::string buf1_str = buf1.str();
+        REQUIRE(buf0.size() == buf1_str.size());
+        REQUIRE(std::equal(begin(buf0), end(buf0), begin(buf1_str)));
+
+        std::vector<int>            aa;
+        std::map<std::string, int>  bb;
+        std::string                 cc;
+
+        {
+            auto in = buffered_source(buf1, 64);
+            deserialize(in, aa);
+            deserialize(in, bb);
+        }
+
+        // Read-ahead bytes were given back to the stream
+        {
+            auto in = source(buf1);
+            deserialize(in, cc);
+        }
+
+        REQUIRE(a == aa);
+        REQUIRE(b == bb);
+        REQUIRE(c == cc);
+
+        auto in = buffered_source(buf1, 64);
+        REQUIRE_THROWS_AS(deserialize(in, cc), std::system_error);
+
+        // A failed flush on destruction sets badbit without throwing, even with exceptions enabled
+        struct full_buf : std::streambuf
+        {
+            std::streamsize xsputn(const char*, std::streamsize) override {return 0;}
+        } full;
+        std::ostream bad(&full);
+        bad.exceptions(std::ios_base::badbit);
+        {
+            auto out = buffered_sink(bad, 64);
+            serialize(out, 1);
+        }
+        REQUIRE(bad.bad());
+
+        // Nothing is written while an exception unwinds
+        std::stringstream buf2;
+        try
+        {
+            auto out = buffered_sink(buf2, 64);
+            serialize(out, 1);
+            throw std::runtime_error("abort");
+        }
+        catch (const std::runtime_error&) {}
+        REQUIRE(buf2.str().empty());
+    }
+
+    TEST_CASE("contiguous sinks and sources")
+    {
+        using vec_sink = decltype(sink(std::declval<std::vector<char>&>()));
+        using vec_src  = decltype(source(std::declval<const std::vector<char>&>()));
+        using str_sink = decltype(sink(std::declval<std::ostream&>()));
+        static_assert(is_contiguous_sink_v<vec_sink>);
+        static_assert(!is_contiguous_sink_v<unchecked_sink>);
+        static_assert(is_contiguous_sink_v<segmented_writer>);
+        static_assert(is_contiguous_sink_v<buffered_ostream>);
+        static_assert(!is_contiguous_sink_v<str_sink>);
+        static_assert(is_contiguous_source_v<vec_src>);
+        static_assert(is_contiguous_source_v<memory_source>);
+        static_assert(!is_contiguous_source_v<buffered_istream>);
+
+        const auto a = std::make_tuple(nullptr, true, -1, 200u, -70000, 1ull << 40, 1.5f, -2.25, "hello"s);
+        const std::vector<int>      b{0, 1, -1, 127, 128, -33, 65536, -2147483647};
+        const std::vector<double>   c{0.5, -1.0e100, 3.0};
+
+        // Contiguous and plain callable sinks must produce identical bytes
+        std::vector<char> buf0, buf1;
+        auto out0 = sink(buf0);
+        auto out1 = [&](const char* bytes, size_t nbytes) { buf1.insert(end(buf1), bytes, bytes + nbytes); };
+        serialize(out0, a);
+        serialize(out0, b);
+        serialize(out0, c);
+        serialize(out1, a);
+        serialize(out1, b);
+        serialize(out1, c);
+        REQUIRE(buf0 == buf1);
+
+        segmented_buffer buf2(16);
+        auto out2 = sink(buf2);
+        serialize(out2, a);
+        serialize(out2, b);
+        serialize(out2, c);
+        REQUIRE(buf2.size() == buf0.size());
+        std::vector<char> buf3(buf2.size());
+        auto in3 = source(buf2);
+        in3(buf3.data(), buf3.size());
+        REQUIRE(buf3 == buf0);
+
+        std::decay_t<decltype(a)> aa{};
+        std::vector<int>    bb;
+        std::vector<double> cc;
+        auto in = source(buf0.data(), buf0.size());
+        deserialize(in, aa);
+        deserialize(in, bb);
+        deserialize(in, cc);
+        REQUIRE(a == aa);
+        REQUIRE(b == bb);
+        REQUIRE(c == cc);
+        REQUIRE(in.remaining() == 0);
+
+        // Truncated input is detected with a single check per object
+        auto in2 = source(buf0.data(), buf0.size() - 1);
+        deserialize(in2, aa);
+        deserialize(in2, bb);
+        REQUIRE_THROWS_AS(deserialize(in2, cc), std::system_error);
+    }
+
+    TEST_CASE("trusted source")
+    {
+        static_assert(is_trusted_source_v<trusted_reader>);
+        static_assert(is_contiguous_source_v<trusted_reader>);
+        static_assert(!is_trusted_source_v<memory_source>);
+
+        const auto a = std::make_tuple(nullptr, false, -33, 65536u, 1ll << 50, 2.5f, -0.125, "trusted"s);
+        const std::vector<int16_t>          b{-300, 0, 5, 32767};
+        const std::map<std::string, float>  c{{"x", 1.0f}, {"y", -1.0f}};
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        serialize(out, a);
+        serialize(out, b);
+        serialize(out, c);
+
+        std::decay_t<decltype(a)>       aa{};
+        std::vector<int16_t>            bb;
+        std::map<std::string, float>    cc;
+        auto in = trusted_source(buf, buf.size());
+        deserialize(in, aa);
+        deserialize(in, bb);
+        deserialize(in, cc);
+        REQUIRE(a == aa);
+        REQUIRE(b == bb);
+        REQUIRE(c == cc);
+        REQUIRE(in.remaining() == 0);
+
+        auto in2 = trusted_source(buf);
+        value jv = unpack(in2);
+        REQUIRE(jv.as_array().size() == std::tuple_size_v<decltype(aa)>);
+        REQUIRE(jv.as_array()[7].as_str() == "trusted");
+
+        // The only check: the frame must fit in the buffer
+        REQUIRE_THROWS_AS(trusted_source(buf, buf.size() + 1), std::system_error);
+    }
+
+    TEST_CASE("type-erased sink and source")
+    {
+        const auto a = std::make_tuple(nullptr, true, -1000, 3.5, "erased"s, std::vector<char>{1, 2, 3});
+        const value b = {{"list", {1, -2, 3.5}}, {"name", "b"}};
+
+        std::vector<char> buf0;
+        auto out0 = sink(buf0);
+        serialize(out0, a);
+        b.pack(out0);
+
+        std::vector<char> buf1;
+        auto     out1 = sink(buf1);
+        any_sink out{out1};
+        serialize(out, a);
+        b.pack(out);
+        REQUIRE(buf0 == buf1);
+
+        std::stringstream ss;
+        auto     sout = sink(ss);
+        any_sink out2{sout};
+        serialize(out2, a);
+        b.pack(out2);
+
+        std::decay_t<decltype(a)> aa;
+        value bb;
+        auto       sin = source(ss);
+        any_source in{sin};
+        deserialize(in, aa);
+        bb.unpack(in);
+        REQUIRE(a == aa);
+        REQUIRE(bb.at("list").as_array()[1].as_int64() == -2);
+
+        auto       in1 = source(buf1);
+        any_source in2{in1};
+        skip(in2);
+        skip(in2);
+        REQUIRE(in1.remaining() == 0);
+    }
+}
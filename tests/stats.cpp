@@ -0,0 +1,166 @@
+#include <random>
+#include <sstream>
+#include "doctest.h"
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+#include "msgpack_stats.h"
+
+using namespace std;
+using namespace msgpackcpp;
+
+namespace msgpackcpp
+{
+    static bool operator==(const format_stats::entry& a, const format_stats::entry& b)
+    {
+        return a.count == b.count && a.bytes == b.bytes;
+    }
+
+    static bool operator==(const format_stats& a, const format_stats& b)
+    {
+        return std::equal(begin(a.families), end(a.families), begin(b.families)) &&
+               a.map_keys == b.map_keys && a.total_bytes == b.total_bytes;
+    }
+}
+
+TEST_SUITE("[STATS]")
+{
+    TEST_CASE("format families")
+    {
+        const std::map<std::string, value> m = {
+            {"id",      value(uint64_t{300})},
+            {"gain",    value(0.5)},
+            {"name",    value(std::string(40, 'x'))},
+            {"samples", value(std::vector<value>{value(int64_t{1}), value(int64_t{-2}), value(int64_t{-200})})},
+            {"blob",    value(std::vector<char>(10, 1))}
+        };
+
+        std::vector<char> buf;
+        auto out   = sink(buf);
+        auto sout  = with_stats(out);
+        value(m).pack(sout);
+        serialize(sout, nullptr);
+        serialize(sout, true);
+
+        const format_stats& s = sout.stats();
+        REQUIRE(s.total_bytes == buf.size());
+        REQUIRE(s.families[FAMILY_FIXMAP].count == 1);
+        REQUIRE(s.families[FAMILY_FIXMAP].bytes == 1);
+        REQUIRE(s.families[FAMILY_FIXARR].count == 1);
+        REQUIRE(s.families[FAMILY_FIXINT].count == 2);
+        REQUIRE(s.families[FAMILY_I16].count == 1);
+        REQUIRE(s.families[FAMILY_I16].bytes == 3);
+        REQUIRE(s.families[FAMILY_U16].count == 1);
+        REQUIRE(s.families[FAMILY_F64].bytes == 9);
+        REQUIRE(s.families[FAMILY_STR8].count == 1);
+        REQUIRE(s.families[FAMILY_STR8].bytes == 42);
+        REQUIRE(s.families[FAMILY_BIN8].bytes == 12);
+        REQUIRE(s.families[FAMILY_NIL].count == 1);
+        REQUIRE(s.families[FAMILY_BOOL].count == 1);
+
+        // 5 keys: fixstr, all in key position
+        REQUIRE(s.families[FAMILY_FIXSTR].count == 5);
+        REQUIRE(s.map_keys.count == 5);
+        REQUIRE(s.map_keys.bytes == s.families[FAMILY_FIXSTR].bytes);
+        REQUIRE(s.map_keys.bytes == 5 + 5 + 3 + 5 + 8); // blob, gain, id, name, samples
+
+        std::ostringstream table;
+        s.print(table);
+        REQUIRE(table.str().find("map keys") != std::string::npos);
+        REQUIRE(table.str().find("str8") != std::string::npos);
+        REQUIRE(table.str().find("uint64") == std::string::npos);
+    }
+
+    TEST_CASE("chunked input")
+    {
+        std::mt19937 eng(7);
+        const auto a = std::make_tuple(std::vector<std::string>{"a", std::string(300, 'b'), std::string(70000, 'c')},
+                                       std::map<int, std::vector<double>>{{-1, {1.0, 2.0}}, {1 << 20, {}}},
+                                       std::vector<uint8_t>(1000, 3), 1ull << 40, -(1ll << 40), 3.5f);
+        std::vector<char> buf;
+        auto out = sink(buf);
+        serialize(out, a);
+        serialize(out, a);
+
+        format_counter whole;
+        whole.consume(buf.data(), buf.size());
+        REQUIRE(whole.stats().total_bytes == buf.size());
+        REQUIRE(whole.stats().families[FAMILY_STR16].count == 2);
+        REQUIRE(whole.stats().families[FAMILY_STR32].count == 2);
+        REQUIRE(whole.stats().families[FAMILY_I64].count == 2);
+
+        format_counter bytewise;
+        for (char c : buf)
+            bytewise.consume(&c, 1);
+        REQUIRE(bytewise.stats() == whole.stats());
+
+        format_counter chunked;
+        for (size_t i = 0 ; i < buf.size() ; )
+        {
+            const size_t n = std::min<size_t>(eng() % 20, buf.size() - i);
+            chunked.consume(buf.data() + i, n);
+            i += n;
+        }
+        REQUIRE(chunked.stats() == whole.stats());
+
+        format_stats sum;
+        sum += whole.stats();
+        sum += chunked.stats();
+        REQUIRE(sum.total_bytes == 2 * buf.size());
+
+        chunked.reset();
+        REQUIRE(chunked.stats().total_bytes == 0);
+    }
+
+    TEST_CASE("sources")
+    {
+        const auto a = std::make_tuple(std::map<std::string, int>{{"x", 1}, {"yy", -70000}}, "str"s, std::vector<float>{1, 2, 3});
+        std::vector<char> buf;
+        auto out  = sink(buf);
+        auto sout = with_stats(out);
+        serialize(sout, a);
+
+        // Contiguous source: counted through advance()
+        std::decay_t<decltype(a)> aa;
+        auto in  = source(buf);
+        auto sin = with_stats(in);
+        static_assert(is_contiguous_source_v<decltype(sin)>);
+        deserialize(sin, aa);
+        REQUIRE(a == aa);
+        REQUIRE(sin.stats() == sout.stats());
+
+        // Stream source: counted through operator()
+        std::stringstream ss;
+        ss.write(buf.data(), buf.size());
+        std::decay_t<decltype(a)> bb;
+        auto in2  = source(ss);
+        auto sin2 = with_stats(in2);
+        static_assert(!is_contiguous_source_v<decltype(sin2)>);
+        deserialize(sin2, bb);
+        REQUIRE(a == bb);
+        REQUIRE(sin2.stats() == sout.stats());
+    }
+
+    TEST_CASE("forwarding")
+    {
+        // The encoding policy of the wrapped sink is kept
+        std::vector<char> buf;
+        auto out   = sink(buf);
+        auto fixed = with_policy<fixed_encoding>(out);
+        auto sout  = with_stats(fixed);
+        static_assert(uses_fixed_encoding<decltype(sout)>);
+        serialize(sout, uint32_t(1));
+        REQUIRE(buf.size() == 5);
+        REQUIRE(sout.stats().families[FAMILY_U32].count == 1);
+        REQUIRE(sout.position() == 5);
+
+        // So are the position and trust of the wrapped source
+        uint32_t x{};
+        auto in  = trusted_source(buf);
+        auto sin = with_stats(in);
+        static_assert(is_trusted_source_v<decltype(sin)>);
+        static_assert(!is_trusted_source_v<decltype(with_stats(std::declval<decltype(source(buf))&>()))>);
+        deserialize(sin, x);
+        REQUIRE(x == 1);
+        REQUIRE(sin.position() == 5);
+    }
+}
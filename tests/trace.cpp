@@ -0,0 +1,177 @@
+// Built into its own executable: MSGPACK_ENABLE_TRACING must be defined for the whole program
+#ifndef MSGPACK_ENABLE_TRACING
+#error "tests/trace.cpp requires MSGPACK_ENABLE_TRACING"
+#endif
+#include <string>
+#include <vector>
+#include <boost/describe/class.hpp>
+#include "doctest.h"
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+#include "msgpack_describe.h"
+
+using namespace std;
+using namespace msgpackcpp;
+
+namespace trace_test
+{
+    struct point
+    {
+        int         x{};
+        std::string label;
+        std::vector<double> weights;
+    };
+
+    BOOST_DESCRIBE_STRUCT(point, (), (x, label, weights))
+
+    struct recorder : tracer
+    {
+        struct call
+        {
+            bool        entering{};
+            trace_event ev;
+        };
+
+        std::vector<call> calls;
+
+        void enter(const trace_event& ev) override { calls.push_back({true, ev}); }
+        void exit(const trace_event& ev)  override { calls.push_back({false, ev}); }
+    };
+}
+
+TEST_SUITE("[TRACE]")
+{
+    TEST_CASE("composites")
+    {
+        using namespace trace_test;
+
+        const auto a = std::make_tuple(std::vector<int>{1, 2, 3}, std::map<std::string, int>{{"a", 1}, {"b", 2}});
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        recorder r;
+        {
+            trace_guard guard(r);
+            REQUIRE(thread_tracer() == &r);
+            serialize(out, a);
+        }
+        REQUIRE(thread_tracer() == nullptr);
+
+        // tuple{array, map}, properly nested
+        REQUIRE(r.calls.size() == 6);
+        REQUIRE(r.calls[0].entering);
+        REQUIRE(r.calls[0].ev.kind == TRACE_TUPLE);
+        REQUIRE(r.calls[0].ev.count == 2);
+        REQUIRE(r.calls[0].ev.offset == 0);
+        REQUIRE(r.calls[1].ev.kind == TRACE_ARRAY);
+        REQUIRE(r.calls[1].ev.count == 3);
+        REQUIRE(r.calls[1].ev.offset == 1);
+        REQUIRE(!r.calls[2].entering);
+        REQUIRE(r.calls[2].ev.kind == TRACE_ARRAY);
+        REQUIRE(r.calls[3].ev.kind == TRACE_MAP);
+        REQUIRE(r.calls[3].ev.offset == 5);
+        REQUIRE(r.calls[3].ev.count == 2);
+        REQUIRE(r.calls[5].ev.kind == TRACE_TUPLE);
+        REQUIRE(!r.calls[5].entering);
+        REQUIRE(r.calls[5].ev.serializing);
+        REQUIRE(r.calls[5].ev.cycles >= r.calls[4].ev.cycles);
+
+        // Counts are known on exit when deserializing
+        r.calls.clear();
+        std::decay_t<decltype(a)> aa;
+        auto in = source(buf);
+        {
+            trace_guard guard(r);
+            deserialize(in, aa);
+        }
+        REQUIRE(a == aa);
+        REQUIRE(r.calls.size() == 6);
+        REQUIRE(!r.calls[0].ev.serializing);
+        REQUIRE(r.calls[0].ev.count == 0);
+        REQUIRE(r.calls[2].ev.count == 3);
+        REQUIRE(r.calls[4].ev.offset == 5);
+        REQUIRE(r.calls[4].ev.count == 2);
+        REQUIRE(r.calls[5].ev.count == 2);
+
+        // No tracer installed: nothing recorded
+        r.calls.clear();
+        serialize(out, a);
+        REQUIRE(r.calls.empty());
+    }
+
+    TEST_CASE("described structs")
+    {
+        using namespace trace_test;
+
+        const point p{3, "origin", {0.5, 1.5}};
+        std::vector<char> buf;
+        auto out = sink(buf);
+        recorder r;
+        {
+            trace_guard guard(r);
+            serialize(out, p, true);
+        }
+
+        std::vector<std::string> members;
+        for (const auto& c : r.calls)
+            if (c.entering && c.ev.kind == TRACE_MEMBER)
+                members.push_back(c.ev.name);
+        REQUIRE(members == std::vector<std::string>{"x", "label", "weights"});
+        REQUIRE(r.calls.front().ev.kind == TRACE_STRUCT);
+        REQUIRE(r.calls.front().ev.count == 3);
+        REQUIRE(r.calls.back().ev.kind == TRACE_STRUCT);
+
+        // The weights array is nested in its member
+        REQUIRE(r.calls.size() == 10);
+        REQUIRE(r.calls[6].ev.kind == TRACE_ARRAY);
+        REQUIRE(r.calls[7].ev.kind == TRACE_ARRAY);
+        REQUIRE(r.calls[8].ev.kind == TRACE_MEMBER);
+        REQUIRE(std::string(r.calls[8].ev.name) == "weights");
+
+        r.calls.clear();
+        point pp;
+        const char* data = buf.data();
+        auto in = source(data, buf.size());
+        {
+            trace_guard guard(r);
+            deserialize(in, pp, true);
+        }
+        REQUIRE(pp.label == p.label);
+        REQUIRE(r.calls.size() == 10);
+        REQUIRE(r.calls[6].ev.offset == buf.size() - 2*9 - 1);
+    }
+
+    TEST_CASE("values")
+    {
+        using namespace trace_test;
+
+        const value v(std::map<std::string, value>{{"a", value(std::vector<value>{value(1), value(2)})}, {"b", value(nullptr)}});
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        recorder r;
+        {
+            trace_guard guard(r);
+            v.pack(out);
+        }
+        REQUIRE(r.calls.size() == 4);
+        REQUIRE(r.calls[0].ev.kind == TRACE_MAP);
+        REQUIRE(std::string(r.calls[0].ev.name) == "value");
+        REQUIRE(r.calls[1].ev.kind == TRACE_ARRAY);
+        REQUIRE(r.calls[1].ev.offset == 3);
+
+        // Offsets point at the header even though it is read first
+        r.calls.clear();
+        value vv;
+        auto in = trusted_source(buf);
+        {
+            trace_guard guard(r);
+            vv.unpack(in);
+        }
+        REQUIRE(r.calls.size() == 4);
+        REQUIRE(r.calls[0].ev.offset == 0);
+        REQUIRE(r.calls[0].ev.count == 2);
+        REQUIRE(r.calls[1].ev.offset == 3);
+        REQUIRE(r.calls[1].ev.count == 2);
+    }
+}
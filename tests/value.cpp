@@ -1,4 +1,8 @@
+#include <random>
 #include <sstream>
+#include <thread>
+#include <atomic>
+#include <unordered_set>
 #include "doctest.h"
 #include "msgpack.h"
 #include "msgpack_sinks.h"
@@ -137,5 +141,516 @@ TEST_SUITE("[VALUE]")
         value jv3 = unpack(in1);
         check_niels(jv2);
         check_niels(jv3);
-    } 
-}
\ No newline at end of file
+    }
+
+    TEST_CASE("map keys")
+    {
+        const value_key a("short");
+        const value_key b(std::string(40, 'k'));
+        REQUIRE(sizeof(value_key) == 16);
+        REQUIRE(a.is_inline());
+        REQUIRE(a.use_count() == 0);
+        REQUIRE(a == "short"sv);
+        REQUIRE(!b.is_inline());
+        REQUIRE(b.size() == 40);
+        REQUIRE(b.str() == std::string(40, 'k'));
+
+        value_key c = b;
+        REQUIRE(b.use_count() == 2);
+        REQUIRE(c == b);
+        value_key d = std::move(c);
+        REQUIRE(c.empty());
+        REQUIRE(b.use_count() == 2);
+        d = a;
+        REQUIRE(b.use_count() == 1);
+        REQUIRE(d == a);
+
+        // Same order as std::string keys
+        const std::vector<std::string> names = {"", "a", "ab", "b", std::string(16, 'a'), std::string(15, 'a'), "\xff", std::string(20, 'z')};
+        for (const auto& x : names)
+            for (const auto& y : names)
+            {
+                REQUIRE((value_key(x) < value_key(y)) == (x < y));
+                REQUIRE((value_key(x) == value_key(y)) == (x == y));
+            }
+
+        value jv;
+        jv[std::string(30, 'x')] = 1;
+        jv["y"]                  = 2;
+        jv[std::string(30, 'x')] = 3;
+        REQUIRE(jv.size() == 2);
+        REQUIRE(jv.at(std::string(30, 'x')).as_int64() == 3);
+        REQUIRE_THROWS_AS(jv.at("z"), std::out_of_range);
+    }
+
+    TEST_CASE("interned keys")
+    {
+        const std::string long1 = "a_rather_long_field_name";
+        const std::string long2 = "another_rather_long_field_name";
+
+        std::vector<value> rows;
+        for (int i = 0 ; i < 100 ; ++i)
+            rows.push_back(value(std::map<std::string, value>{{long1, value(i)}, {long2, value(-i - 1)}, {"id", value(i)}}));
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        value(rows).pack(out);
+
+        key_interner keys;
+        auto in = source(buf);
+        value jv = unpack(in, keys);
+        REQUIRE(keys.size() == 2);
+        REQUIRE(jv.size() == 100);
+        for (int i = 0 ; i < 100 ; ++i)
+        {
+            REQUIRE(jv[i].at(long1).as_uint64() == uint64_t(i));
+            REQUIRE(jv[i].at(long2).as_int64() == -i - 1);
+            REQUIRE(jv[i].at("id").as_uint64() == uint64_t(i));
+        }
+
+        // Every row shares the table's copy
+        const value_key& k = jv[0].as_object().begin()->first;
+        REQUIRE(k == long1);
+        REQUIRE(k.use_count() == 101);
+
+        // Stream sources go through a scratch buffer
+        std::stringstream ss;
+        ss.write(buf.data(), buf.size());
+        auto in2 = source(ss);
+        value jv2;
+        jv2.unpack(in2, keys);
+        REQUIRE(keys.size() == 2);
+        REQUIRE(k.use_count() == 201);
+        REQUIRE(jv2[99].at(long2).as_int64() == -100);
+
+        // Without an interner every row owns its keys
+        auto in3 = source(buf);
+        value jv3 = unpack(in3);
+        REQUIRE(jv3[0].as_object().begin()->first.use_count() == 1);
+
+        // Bounded table
+        key_interner small(1);
+        auto in4 = source(buf);
+        value jv4 = unpack(in4, small);
+        REQUIRE(small.size() == 1);
+        REQUIRE(jv4[0].as_object().begin()->first.use_count() == 101);
+        REQUIRE(std::next(jv4[0].as_object().begin())->first.use_count() == 1);
+        small.clear();
+        REQUIRE(jv4[0].as_object().begin()->first.use_count() == 100);
+    }
+
+    TEST_CASE("compact storage")
+    {
+        static_assert(sizeof(value) == 16);
+
+        value a("fourteen bytes");
+        value b(std::string(100, 'b'));
+        REQUIRE(a.is_str());
+        REQUIRE(b.is_str());
+        REQUIRE(std::as_const(a).as_str() == "fourteen bytes");
+        REQUIRE(std::as_const(b).as_str() == std::string(100, 'b'));
+
+        // Const access is a view, whether the string is inline or not
+        static_assert(std::is_same_v<decltype(std::as_const(a).as_str()), std::string_view>);
+        static_assert(std::is_same_v<decltype(a.as_str()), std::string&>);
+        REQUIRE(std::string(std::as_const(a).as_str()) == "fourteen bytes");
+
+        // Mutable access moves a short string out of line
+        a.as_str() += " and more";
+        REQUIRE(std::as_const(a).as_str() == "fourteen bytes and more");
+
+        value c = b;
+        c.as_str()[0] = 'c';
+        REQUIRE(std::as_const(b).as_str()[0] == 'b');
+        REQUIRE(std::as_const(c).as_str()[0] == 'c');
+
+        value d = std::move(c);
+        REQUIRE(c.is_null());
+        REQUIRE(d.size() == 1);
+
+        // Assigning a child to its parent
+        value e = {value(std::vector<value>{value(1), value("x")}), value(2)};
+        e = std::move(e[0]);
+        REQUIRE(e.is_array());
+        REQUIRE(e.size() == 2);
+        REQUIRE(e[1].as_str() == "x");
+        e = e[1];
+        REQUIRE(std::as_const(e).as_str() == "x");
+
+        REQUIRE_THROWS_AS(e.as_int64(), std::bad_variant_access);
+        REQUIRE_THROWS_AS(e.as_array(), std::bad_variant_access);
+        REQUIRE_THROWS_AS(value(true).as_str(), std::bad_variant_access);
+
+        // Round trip through every kind of node
+        const value all = {value(nullptr), value(true), value(-1), value(1u), value(0.5), value(""), value(std::string(14, 's')),
+                           value(std::string(15, 's')), value(std::vector<char>{1, 2}), value(std::vector<value>{}),
+                           value(std::map<std::string, value>{{"k", value("v")}})};
+        std::vector<char> buf;
+        auto out = sink(buf);
+        all.pack(out);
+        auto in = source(buf);
+        const value all2 = unpack(in);
+        std::vector<char> buf2;
+        auto out2 = sink(buf2);
+        all2.pack(out2);
+        REQUIRE(buf2 == buf);
+        REQUIRE(all2[7].as_str().size() == 15);
+        REQUIRE(all2[10].at("k").as_str() == "v");
+    }
+
+    TEST_CASE("typed arrays")
+    {
+        std::mt19937 eng(3);
+        std::vector<double>  f64(1000);
+        std::vector<int64_t> i64(1000);
+        for (auto& x : f64) x = std::uniform_real_distribution<double>(-1, 1)(eng);
+        for (auto& x : i64) x = int64_t(eng()) - int64_t(eng());
+        const std::vector<float> f32(f64.begin(), f64.end());
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        serialize_array_size(out, 9);
+        serialize(out, f64);
+        serialize(out, i64);
+        serialize(out, f32);
+        serialize(out, std::vector<int>{1, -2, 3});
+        value(std::vector<value>{value(1), value(2.5)}).pack(out);
+        value(std::vector<value>{value(0.5), value("x")}).pack(out);
+        serialize(out, std::vector<int>{});
+        serialize(out, std::vector<uint64_t>{1, 1ull << 63});
+        value(std::vector<value>{value(1), value(2), value("three")}).pack(out);
+
+        unpack_options opts;
+        opts.typed_arrays = true;
+
+        for (int contiguous = 0 ; contiguous < 2 ; ++contiguous)
+        {
+            std::stringstream ss;
+            ss.write(buf.data(), buf.size());
+            auto  in0 = source(buf);
+            auto  in1 = source(ss);
+            value jv  = contiguous ? unpack(in0, opts) : unpack(in1, opts);
+
+            REQUIRE(jv[0].is_array());
+            REQUIRE(jv[0].is_f64_array());
+            REQUIRE(jv[0].as_f64_array() == f64);
+            REQUIRE(jv[1].is_i64_array());
+            REQUIRE(jv[1].size() == 1000);
+            REQUIRE(jv[1].as_i64_array() == i64);
+            REQUIRE(jv[2].is_f64_array());
+            REQUIRE(jv[2].as_f64_array()[10] == double(f32[10]));
+            REQUIRE(jv[3].as_i64_array() == std::vector<int64_t>{1, -2, 3});
+
+            // Mixed arrays fall back to generic ones
+            REQUIRE(!jv[4].is_i64_array());
+            REQUIRE(std::as_const(jv[4]).as_array()[1].as_real() == 2.5);
+            REQUIRE(!jv[5].is_f64_array());
+            REQUIRE(std::as_const(jv[5]).as_array()[1].as_str() == "x");
+            REQUIRE(std::as_const(jv[6]).as_array().empty());
+            REQUIRE(std::as_const(jv[7]).as_array()[1].as_uint64() == 1ull << 63);
+            REQUIRE(std::as_const(jv[8]).as_array()[1].as_uint64() == 2);
+            REQUIRE(std::as_const(jv[8]).as_array()[2].as_str() == "three");
+
+            // Typed arrays pack to the same bytes, bar the float widths
+            std::vector<char> buf2;
+            auto out2 = sink(buf2);
+            jv.pack(out2);
+            auto  in2 = source(buf2);
+            value jv2 = unpack(in2);
+            REQUIRE(std::as_const(jv2[1]).as_array().size() == 1000);
+            REQUIRE(std::as_const(jv2[1]).as_array()[7].is_int());
+
+            // Const generic access reads a copy and leaves the array typed
+            const value& cv = jv[1];
+            REQUIRE(cv.as_array().size() == 1000);
+            REQUIRE(cv[7] == value(i64[7]));
+            REQUIRE(&cv.as_array() == &cv.as_array());
+            REQUIRE(cv.is_i64_array());
+            jv[1].as_i64_array()[7] = -7;
+            REQUIRE(cv[7].as_int64() == -7);
+
+            // Non-const generic access converts
+            REQUIRE(jv[0].as_array()[3].as_real() == f64[3]);
+            REQUIRE(!jv[0].is_f64_array());
+        }
+
+        // Off by default
+        auto  in  = source(buf);
+        value jv3 = unpack(in);
+        REQUIRE(!jv3[0].is_f64_array());
+
+        const value a(std::vector<double>{1.0, 2.0});
+        const value b = a;
+        REQUIRE(b.as_f64_array() == std::vector<double>{1.0, 2.0});
+        std::vector<char> buf3;
+        auto out3 = sink(buf3);
+        b.pack(out3);
+        std::vector<double> back;
+        auto in3 = source(buf3);
+        deserialize(in3, back);
+        REQUIRE(back == b.as_f64_array());
+    }
+
+    TEST_CASE("lazy subtrees")
+    {
+        const value payload(std::map<std::string, value>{
+            {"name",   value("sensor")},
+            {"values", value(std::vector<value>{value(1), value(2), value(3)})},
+            {"nested", value(std::map<std::string, value>{{"deep", value(std::vector<value>{value(1.5), value(2.5)})}})}
+        });
+
+        // A payload array with a non-minimal header, which an eager unpack wouldn't preserve
+        const char raw[] = {char(0xdd), 0, 0, 0, 2, 1, 2};
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        serialize_map_size(out, 3);
+        serialize(out, "id");
+        serialize(out, 7);
+        serialize(out, "payload");
+        payload.pack(out);
+        serialize(out, "raw");
+        out(raw, sizeof(raw));
+
+        unpack_options opts;
+        opts.lazy         = true;
+        opts.typed_arrays = true;
+
+        for (int contiguous = 0 ; contiguous < 2 ; ++contiguous)
+        {
+            std::stringstream ss;
+            ss.write(buf.data(), buf.size());
+            auto  in0 = source(buf);
+            auto  in1 = source(ss);
+            value jv  = contiguous ? unpack(in0, opts) : unpack(in1, opts);
+
+            // The envelope is decoded, the rest is answered from the headers
+            REQUIRE(jv.is_object());
+            REQUIRE(jv.size() == 3);
+            REQUIRE(jv.at("id").as_uint64() == 7);
+            REQUIRE(jv.at("payload").is_object());
+            REQUIRE(jv.at("payload").size() == 3);
+            REQUIRE(jv.at("raw").is_i64_array());
+            REQUIRE(jv.at("raw").size() == 2);
+
+            // Untouched subtrees are forwarded verbatim
+            std::vector<char> buf2;
+            auto out2 = sink(buf2);
+            jv.pack(out2);
+            REQUIRE(buf2 == buf);
+
+            // Copies stay lazy
+            const value cp = jv.at("payload");
+            REQUIRE(cp.at("name").as_str() == "sensor");
+            REQUIRE(cp.at("nested").at("deep").as_f64_array() == std::vector<double>{1.5, 2.5});
+            REQUIRE(jv.at("raw").as_i64_array() == std::vector<int64_t>{1, 2});
+
+            // Decoded on access, then mutable
+            jv["payload"]["values"][1] = value("two");
+            jv["payload"]["name"]      = value(nullptr);
+            buf2.clear();
+            jv.pack(out2);
+            auto  in2 = source(buf2);
+            value jv2 = unpack(in2);
+            REQUIRE(jv2.at("payload").at("values")[0].as_uint64() == 1);
+            REQUIRE(jv2.at("payload").at("values")[1].as_str() == "two");
+            REQUIRE(jv2.at("payload").at("name").is_null());
+            REQUIRE(jv2.at("payload").at("nested").at("deep")[1].as_real() == 2.5);
+            REQUIRE(jv2.at("raw").size() == 2);
+        }
+
+        // Errors inside a subtree surface when it is accessed
+        std::vector<char> bad;
+        auto out3 = sink(bad);
+        serialize_array_size(out3, 1);
+        serialize_array_size(out3, 1);
+        serialize_map_size(out3, 1);
+        serialize(out3, 1);
+        serialize(out3, 2);
+
+        auto  in3 = source(bad);
+        value jv3 = unpack(in3, opts);
+        REQUIRE(jv3[0][0].is_object());
+        REQUIRE_THROWS_AS(jv3[0][0].as_object(), std::system_error);
+
+        // Truncated input still fails up front
+        auto in4 = source(bad.data(), bad.size() - 1);
+        REQUIRE_THROWS_AS(unpack(in4, opts), std::system_error);
+
+        // Const accesses don't rewrite the tree, so they can be made from several threads
+        auto        in5 = source(buf);
+        const value jv5 = unpack(in5, opts);
+        std::atomic<int>         found{0};
+        std::vector<std::thread> readers;
+        for (int t = 0 ; t < 4 ; ++t)
+            readers.emplace_back([&] {found += jv5.at("payload").at("nested").at("deep").as_f64_array()[1] == 2.5;});
+        for (auto& t : readers)
+            t.join();
+        REQUIRE(found == 4);
+        auto in6 = source(buf);
+        REQUIRE(jv5 == unpack(in6));
+
+        std::vector<char> buf5;
+        auto out5 = sink(buf5);
+        jv5.pack(out5);
+        REQUIRE(buf5 == buf);
+    }
+
+    TEST_CASE("equality and hashing")
+    {
+        const auto same = [](const value& a, const value& b) {
+            return a == b && !(a != b) && msgpackcpp::hash(a) == msgpackcpp::hash(b);
+        };
+
+        REQUIRE(same(value(5), value(5u)));
+        REQUIRE(value(-5) != value(uint64_t(-5)));
+        REQUIRE(value(1) != value(1.0));
+        REQUIRE(same(value(std::numeric_limits<double>::quiet_NaN()), value(-std::numeric_limits<double>::quiet_NaN())));
+        REQUIRE(value(0.0) != value(-0.0));
+
+        value s1("short");
+        value s2("short");
+        s2.as_str();
+        REQUIRE(same(s1, s2));
+
+        REQUIRE(same(value(std::vector<int64_t>{1, -2}), value(std::vector<value>{value(1u), value(-2)})));
+        REQUIRE(same(value(std::vector<double>{0.5}), value(std::vector<value>{value(0.5)})));
+        REQUIRE(same(value(std::vector<int64_t>{}), value(std::vector<double>{})));
+        REQUIRE(value(std::vector<int64_t>{1}) != value(std::vector<double>{1.0}));
+        REQUIRE(value(std::vector<int64_t>{1, 2}) != value(std::vector<value>{value(1), value("2")}));
+
+        value m1, m2;
+        m1["b"] = value(std::vector<value>{value(nullptr), value(true)});
+        m1["a"] = value("x");
+        m2["a"] = value("x");
+        m2["b"] = value(std::vector<value>{value(nullptr), value(true)});
+        REQUIRE(same(m1, m2));
+        m2["b"][1] = value(false);
+        REQUIRE(m1 != m2);
+        REQUIRE(msgpackcpp::hash(m1) != msgpackcpp::hash(m2));
+
+        // Lazy subtrees compare and hash by content, even with non-canonical headers
+        std::vector<char> buf;
+        auto out  = sink(buf);
+        auto fout = with_policy<fixed_encoding>(out);
+        serialize_array_size(fout, 2);
+        m1.pack(fout);
+        serialize(fout, std::vector<int>{1, 2, 3});
+
+        unpack_options opts;
+        opts.lazy = true;
+        auto  in0   = source(buf);
+        auto  in1   = source(buf);
+        value lazy  = unpack(in0, opts);
+        value eager = unpack(in1);
+        REQUIRE(same(lazy, eager));
+        REQUIRE(same(lazy[0], m1));
+        REQUIRE(lazy[1] == value(std::vector<int64_t>{1, 2, 3}));
+
+        std::vector<char> c1, c2;
+        auto o1 = sink(c1);
+        auto o2 = sink(c2);
+        auto p1 = with_policy<canonical_encoding>(o1);
+        lazy.pack(p1);
+        eager.pack(o2);
+        REQUIRE(c1 == c2);
+        REQUIRE(c1.size() < buf.size());
+
+        // Other policies re-encode lazy subtrees rather than forwarding their minimal bytes
+        auto  in2    = source(c2);
+        auto  in3    = source(c2);
+        value lazy2  = unpack(in2, opts);
+        value eager2 = unpack(in3);
+        std::vector<char> f1, f2;
+        auto w1 = sink(f1);
+        auto w2 = sink(f2);
+        auto q1 = with_policy<fixed_encoding>(w1);
+        auto q2 = with_policy<fixed_encoding>(w2);
+        lazy2.pack(q1);
+        eager2.pack(q2);
+        REQUIRE(f1 == f2);
+        REQUIRE(f1.size() > c2.size());
+
+        std::unordered_set<value> set{m1, m2, value(5), value(5u)};
+        REQUIRE(set.size() == 3);
+        REQUIRE(set.count(eager[0]) == 1);
+    }
+
+    TEST_CASE("cached encoding")
+    {
+        const auto encode = [](const value& v) {
+            std::vector<char> buf;
+            auto out = sink(buf);
+            v.pack(out);
+            return buf;
+        };
+
+        const auto encode_cached = [](cached_value& v) {
+            std::vector<char> buf;
+            auto out = sink(buf);
+            v.pack(out);
+            return buf;
+        };
+
+        cached_value doc;
+        for (int i = 0 ; i < 100 ; ++i)
+        {
+            value& rec = doc.edit({"record" + std::to_string(i)});
+            rec["id"]   = value(i);
+            rec["list"] = value(std::vector<value>{});
+            for (int j = 0 ; j < 100 ; ++j)
+                rec["list"].as_array().push_back(value(1000000 + i * 1000 + j));
+        }
+        const std::vector<char> full = encode(doc.get());
+        REQUIRE(encode_cached(doc) == full);
+        REQUIRE(encode_cached(doc) == full);
+
+        // Edits invalidate the whole path to them
+        doc.edit({"record5", "list", 3}) = value(-1);
+        doc.edit({"record7"}).at("id")   = value("seven");
+        const std::vector<char> edited = encode_cached(doc);
+        REQUIRE(edited == encode(doc.get()));
+
+        auto  in  = source(edited);
+        value doc2 = unpack(in);
+        REQUIRE(doc2.at("record5").at("list")[3].as_int64() == -1);
+        REQUIRE(doc2.at("record7").at("id").as_str() == "seven");
+        REQUIRE(doc2.at("record8").at("list")[3].as_uint64() == 1008003);
+        REQUIRE_THROWS_AS(doc.edit({"record5", "list", 100}), std::out_of_range);
+
+        // pack() of the document itself never uses the caches
+        value& rec3 = doc.edit({"record3"});
+        REQUIRE(encode_cached(doc) == edited);
+        rec3["id"] = value(nullptr);
+        const std::vector<char> buf2 = encode(doc.get());
+        auto  in2  = source(buf2);
+        REQUIRE(unpack(in2).at("record3").at("id").is_null());
+        doc.edit({"record3"});
+        REQUIRE(encode_cached(doc) == encode(doc.get()));
+
+        // Replacing a subtree, or encoding with another policy
+        doc.edit({"record9"}) = value(nullptr);
+        REQUIRE(encode_cached(doc).size() < full.size());
+
+        std::vector<char> f1, f2;
+        auto s1 = sink(f1);
+        auto s2 = sink(f2);
+        auto p1 = with_policy<fixed_encoding>(s1);
+        auto p2 = with_policy<fixed_encoding>(s2);
+        doc.pack(p1);
+        doc.get().pack(p2);
+        REQUIRE(f1 == f2);
+
+        // Taking the document out and back drops the caches
+        value v = doc.release();
+        REQUIRE(doc.get().is_null());
+        v["record4"]["id"] = value(44);
+        v.at("record6").at("list")[0] = value(66);
+        cached_value doc3(std::move(v));
+        const std::vector<char> buf3 = encode_cached(doc3);
+        auto  in3 = source(buf3);
+        value doc4 = unpack(in3);
+        REQUIRE(doc4.at("record4").at("id").as_uint64() == 44);
+        REQUIRE(doc4.at("record6").at("list")[0].as_uint64() == 66);
+    }
+}
@@ -0,0 +1,167 @@
+#include <random>
+#include "doctest.h"
+#include "msgpack.h"
+#include "msgpack_sinks.h"
+#include "msgpack_view.h"
+
+using namespace std;
+using namespace msgpackcpp;
+
+TEST_SUITE("[VIEW]") 
+{
+    TEST_CASE("skip and encoded size")
+    {
+        const auto a = std::make_tuple(nullptr, true, -33, 1ull << 40, 2.5, "string"s, std::vector<uint8_t>(300, 7),
+                                       std::map<std::string, std::vector<int>>{{"a", {1, 2, 3}}, {"b", {}}});
+        std::vector<char> buf;
+        auto out = sink(buf);
+        serialize(out, a);
+        const size_t len = buf.size();
+        serialize(out, 42);
+
+        REQUIRE(encoded_size(buf.data(), buf.size()) == len);
+        REQUIRE_THROWS_AS(encoded_size(buf.data(), len - 1), std::system_error);
+
+        // Non-contiguous sources skip the same bytes
+        size_t offset{0};
+        auto in = [&](char* bytes, size_t nbytes) {std::memcpy(bytes, buf.data() + offset, nbytes); offset += nbytes;};
+        skip(in);
+        REQUIRE(offset == len);
+        int b{};
+        deserialize(in, b);
+        REQUIRE(b == 42);
+    }
+
+    TEST_CASE("locate")
+    {
+        const std::map<std::string, value> m = {
+            {"seq",     value(uint64_t{7})},
+            {"name",    value("feed")},
+            {"levels",  value(std::vector<value>{value(int64_t{1}), value(int64_t{-2}), value(3.5)})}
+        };
+        std::vector<char> buf;
+        auto out = sink(buf);
+        value(m).pack(out);
+
+        const auto seq = locate(buf, {"seq"});
+        REQUIRE(seq);
+        REQUIRE(seq->size == 1);
+        auto in = source(buf.data() + seq->offset, seq->size);
+        REQUIRE(unpack(in).as_uint64() == 7);
+
+        const auto level = locate(buf, {"levels", 2});
+        REQUIRE(level);
+        REQUIRE(level->size == 9);
+
+        REQUIRE(!locate(buf, {"missing"}));
+        REQUIRE(!locate(buf, {"levels", 3}));
+        REQUIRE(!locate(buf, {"seq", 0}));
+        REQUIRE(!locate(buf, {0}));
+    }
+
+    TEST_CASE("patch")
+    {
+        // uint32 sequence number and int64 timestamp, as a fixed width encoder would write them
+        const std::map<std::string, int64_t> msg = {{"seq", 0}, {"ts", 0}};
+        std::vector<char> buf;
+        auto out0 = sink(buf);
+        auto out  = with_policy<fixed_encoding>(out0);
+        serialize(out, msg);
+        const size_t len = buf.size();
+
+        std::mt19937 eng(std::random_device{}());
+        std::uniform_int_distribution<int64_t> dist;
+
+        for (int repeat = 0 ; repeat < 100 ; ++repeat)
+        {
+            const int64_t ts  = dist(eng);
+            const uint32_t sq = static_cast<uint32_t>(repeat * 1000);
+            REQUIRE(patch(buf.data(), buf.size(), {"seq"}, sq));
+            REQUIRE(patch(buf.data(), buf.size(), {"ts"}, ts));
+            REQUIRE(buf.size() == len);
+
+            std::map<std::string, int64_t> msg2;
+            auto in = source(buf);
+            deserialize(in, msg2);
+            REQUIRE(msg2.at("seq") == sq);
+            REQUIRE(msg2.at("ts")  == ts);
+        }
+
+        // Minimal encodings: values that don't fit are spliced in
+        std::vector<char> buf2;
+        auto out2 = sink(buf2);
+        serialize(out2, std::make_tuple(1, 2.5f, true, "tail"s));
+
+        REQUIRE(patch(buf2.data(), buf2.size(), {0}, -5));
+        REQUIRE(!patch(buf2.data(), buf2.size(), {0}, 1000));
+        REQUIRE(!patch(buf2.data(), buf2.size(), {1}, 0.1));
+        REQUIRE(!patch(buf2.data(), buf2.size(), {2}, 1));
+        REQUIRE(patch(buf2.data(), buf2.size(), {2}, false));
+        REQUIRE(patch(buf2, {0}, 100000));
+        REQUIRE(patch(buf2, {1}, 0.1));
+        REQUIRE(!patch(buf2, {4}, 0));
+
+        std::tuple<int, double, bool, std::string> t;
+        auto in2 = source(buf2);
+        deserialize(in2, t);
+        REQUIRE(t == std::make_tuple(100000, 0.1, false, "tail"s));
+        REQUIRE(in2.remaining() == 0);
+
+        // Shrinking
+        REQUIRE(patch(buf2, {0}, 3));
+        auto in3 = source(buf2);
+        deserialize(in3, t);
+        REQUIRE(std::get<0>(t) == 3);
+        REQUIRE(std::get<3>(t) == "tail");
+    }
+
+    TEST_CASE("find")
+    {
+        // The document from the README example
+        value jv = {
+            {"pi", 3.141},
+            {"happy", true},
+            {"name", "Niels"},
+            {"nothing", nullptr},
+            {"answer", {
+                {"everything", -42}
+            }},
+            {"list", {1, 0, 2}},
+            {"object", {
+                {"currency", "USD"},
+                {"value", 42.99}
+            }},
+            {"a/b~c", 1}
+        };
+
+        std::vector<char> buf;
+        auto out = sink(buf);
+        jv.pack(out);
+
+        const auto currency = find(buf, "/object/currency");
+        REQUIRE(currency);
+        REQUIRE(currency->is_str());
+        REQUIRE(currency->as_str() == "USD");
+        REQUIRE(currency->data() >= buf.data());
+        REQUIRE(currency->data() + currency->size() <= buf.data() + buf.size());
+
+        REQUIRE(find(buf, "/list/2")->as<int>() == 2);
+        REQUIRE(find(buf, "/answer/everything")->as<int64_t>() == -42);
+        REQUIRE(find(buf, "/object/value")->as<double>() == 42.99);
+        REQUIRE(find(buf, "/nothing")->is_null());
+        REQUIRE(find(buf, "/happy")->is_bool());
+        REQUIRE(find(buf, "/list")->is_array());
+        REQUIRE(find(buf, "/a~1b~0c")->as<int>() == 1);
+        REQUIRE(find(buf, "")->size() == buf.size());
+
+        REQUIRE(!find(buf, "/list/3"));
+        REQUIRE(!find(buf, "/list/01"));
+        REQUIRE(!find(buf, "/list/x"));
+        REQUIRE(!find(buf, "/list/99999999999"));
+        REQUIRE(!find(buf, "/pi/0"));
+        REQUIRE(!find(buf, "/object/missing"));
+        REQUIRE_THROWS_AS(find(buf, "object"), std::invalid_argument);
+        REQUIRE_THROWS_AS(find(buf.data(), buf.size() / 2, "/zzz"), std::system_error);
+        REQUIRE_THROWS_AS(find(buf, "/pi")->as_str(), std::system_error);
+    }
+}